@@ -0,0 +1,148 @@
+/*
+ * Pebble Term Watch
+ *
+ * Animation scheduler.
+ */
+#include <pebble.h>
+#include "anim_scheduler.h"
+
+typedef struct {
+  AnimCallback callback;
+  uint32_t deadline;
+  uint32_t remaining; // time left when paused
+  bool active;
+  bool paused;
+} AnimTimeline;
+
+static AnimTimeline timelines[ANIM_MAX_TIMELINES];
+static AppTimer *anim_timer = NULL;
+static bool anim_firing = false;
+
+static uint32_t anim_now(void) {
+  time_t sec;
+  uint16_t ms;
+
+  time_ms(&sec, &ms);
+  return (uint32_t)sec * 1000 + ms;
+}
+
+// signed distance, safe across wrap around
+static int32_t anim_until(uint32_t deadline, uint32_t now) {
+  return (int32_t)(deadline - now);
+}
+
+static void anim_fire(void *data);
+
+// Arms the shared timer for the earliest pending deadline
+static void anim_arm(void) {
+  uint32_t now = anim_now();
+  int32_t earliest = INT32_MAX;
+
+  if (anim_firing) {
+    // anim_fire re-arms once all due callbacks ran
+    return;
+  }
+
+  for (int i = 0; i < ANIM_MAX_TIMELINES; i++) {
+    if (timelines[i].active && !timelines[i].paused) {
+      int32_t until = anim_until(timelines[i].deadline, now);
+      if (until < earliest) {
+        earliest = until;
+      }
+    }
+  }
+
+  if (earliest == INT32_MAX) {
+    if (anim_timer != NULL) {
+      app_timer_cancel(anim_timer);
+      anim_timer = NULL;
+    }
+    return;
+  }
+
+  uint32_t delay = earliest > 0 ? (uint32_t)earliest : 0;
+
+  if (anim_timer == NULL || !app_timer_reschedule(anim_timer, delay)) {
+    anim_timer = app_timer_register(delay, anim_fire, NULL);
+  }
+}
+
+static void anim_fire(void *data) {
+  uint32_t now = anim_now();
+
+  anim_timer = NULL;
+  anim_firing = true;
+
+  for (int i = 0; i < ANIM_MAX_TIMELINES; i++) {
+    AnimTimeline *timeline = &timelines[i];
+
+    if (!timeline->active || timeline->paused
+        || anim_until(timeline->deadline, now) > ANIM_COALESCE_MS) {
+      continue;
+    }
+
+    // one-shot; the callback reschedules itself if it wants to
+    timeline->active = false;
+    timeline->callback();
+  }
+
+  anim_firing = false;
+  anim_arm();
+}
+
+void anim_schedule(uint8_t id, uint32_t delay_ms, AnimCallback callback) {
+  AnimTimeline *timeline = &timelines[id];
+
+  timeline->callback = callback;
+  timeline->deadline = anim_now() + delay_ms;
+  timeline->remaining = delay_ms;
+  timeline->active = true;
+
+  anim_arm();
+}
+
+void anim_cancel(uint8_t id) {
+  timelines[id].active = false;
+  anim_arm();
+}
+
+void anim_pause(uint8_t id, bool paused) {
+  AnimTimeline *timeline = &timelines[id];
+
+  if (timeline->paused == paused) {
+    return;
+  }
+
+  uint32_t now = anim_now();
+
+  if (paused) {
+    int32_t until = anim_until(timeline->deadline, now);
+    timeline->remaining = until > 0 ? (uint32_t)until : 0;
+  } else {
+    timeline->deadline = now + timeline->remaining;
+  }
+  timeline->paused = paused;
+
+  anim_arm();
+}
+
+bool anim_scheduled(uint8_t id) {
+  return timelines[id].active;
+}
+
+bool anim_running(void) {
+  for (uint8_t id = 0; id < ANIM_MAX_TIMELINES; id++) {
+    if (timelines[id].active && !timelines[id].paused) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void anim_deinit(void) {
+  if (anim_timer != NULL) {
+    app_timer_cancel(anim_timer);
+    anim_timer = NULL;
+  }
+  memset(timelines, 0, sizeof(timelines));
+}
@@ -0,0 +1,30 @@
+/*
+ * Pebble Term Watch
+ *
+ * Animation scheduler.
+ * Independent timelines share a single AppTimer, armed for the earliest
+ * deadline. Deadlines within ANIM_COALESCE_MS of each other fire together.
+ */
+#pragma once
+
+#include <pebble.h>
+
+#define ANIM_MAX_TIMELINES (4)
+#define ANIM_COALESCE_MS (40)
+
+typedef void (*AnimCallback)(void);
+
+// (Re)schedules timeline id to run callback once after delay_ms
+void anim_schedule(uint8_t id, uint32_t delay_ms, AnimCallback callback);
+
+void anim_cancel(uint8_t id);
+
+// A paused timeline keeps its callback but never fires until resumed
+void anim_pause(uint8_t id, bool paused);
+
+bool anim_scheduled(uint8_t id);
+
+// True while a timeline will fire, within a second or so for every one in use
+bool anim_running(void);
+
+void anim_deinit(void);
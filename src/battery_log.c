@@ -0,0 +1,117 @@
+/*
+ * Pebble Term Watch
+ *
+ * Battery history.
+ *
+ * Each sample holds the change since the previous one. An interval is
+ * flagged when the watch was charging through it, so a discharge run is
+ * the newest unflagged intervals with no percentage gain.
+ */
+#include <pebble.h>
+#include "battery_log.h"
+
+typedef struct {
+  uint16_t minutes; // since the previous sample (saturated)
+  int8_t percent;   // change since the previous sample
+  uint8_t charging; // charging through the interval
+} __attribute__((__packed__)) BatterySample;
+
+typedef struct {
+  uint32_t time;    // newest sample
+  uint8_t percent;
+  uint8_t charging;
+  uint8_t head;     // next slot
+  uint8_t count;
+  BatterySample samples[BATTERY_LOG_SIZE];
+} __attribute__((__packed__)) BatteryLog;
+
+static BatteryLog battery_log;
+static uint32_t battery_log_key = 0;
+
+void battery_log_load(uint32_t key) {
+  battery_log_key = key;
+
+  if (persist_exists(key)) {
+    persist_read_data(key, &battery_log, sizeof(battery_log));
+  }
+  if (battery_log.head >= BATTERY_LOG_SIZE
+      || battery_log.count > BATTERY_LOG_SIZE) {
+    memset(&battery_log, 0, sizeof(battery_log));
+  }
+}
+
+void battery_log_add(time_t now, uint8_t percent, bool charging) {
+  if (battery_log.time != 0
+      && battery_log.percent == percent
+      && battery_log.charging == charging) {
+    return;
+  }
+
+  if (battery_log.time != 0 && (uint32_t)now > battery_log.time) {
+    uint32_t minutes = ((uint32_t)now - battery_log.time) / 60;
+    BatterySample *sample = &battery_log.samples[battery_log.head];
+
+    sample->minutes = minutes > 0xFFFF ? 0xFFFF : minutes;
+    sample->percent = (int8_t)(percent - battery_log.percent);
+    sample->charging = battery_log.charging;
+
+    battery_log.head = (battery_log.head + 1) % BATTERY_LOG_SIZE;
+    if (battery_log.count < BATTERY_LOG_SIZE) {
+      battery_log.count++;
+    }
+  }
+
+  battery_log.time = now;
+  battery_log.percent = percent;
+  battery_log.charging = charging;
+
+  if (battery_log_key) {
+    persist_write_data(battery_log_key, &battery_log, sizeof(battery_log));
+  }
+}
+
+bool battery_log_rate(uint16_t *tenths_per_day, uint16_t *hours_left) {
+  uint32_t minutes = 0;
+  uint32_t drop = 0;
+
+  if (battery_log.charging) {
+    return false;
+  }
+
+  for (int i = 0; i < battery_log.count; i++) {
+    int index = (battery_log.head + BATTERY_LOG_SIZE - 1 - i) % BATTERY_LOG_SIZE;
+    const BatterySample *sample = &battery_log.samples[index];
+
+    if (sample->charging || sample->percent > 0) {
+      break;
+    }
+    minutes += sample->minutes;
+    drop += -sample->percent;
+  }
+
+  if (drop == 0 || minutes < BATTERY_LOG_MIN_MINUTES) {
+    return false;
+  }
+
+  uint32_t rate = drop * 10 * 24 * 60 / minutes;
+  uint32_t hours = (uint32_t)battery_log.percent * minutes / (drop * 60);
+
+  *tenths_per_day = rate > 9999 ? 9999 : rate;
+  *hours_left = hours > 9999 ? 9999 : hours;
+  return true;
+}
+
+void battery_log_format(char *buf, size_t size) {
+  uint16_t rate, hours;
+
+  if (!battery_log_rate(&rate, &hours)) {
+    snprintf(buf, size, "n/a");
+    return;
+  }
+
+  if (rate < 100) {
+    snprintf(buf, size, "%u.%u%%/d %uh", rate / 10, rate % 10, hours);
+  } else {
+    snprintf(buf, size, "%u%%/d %uh", rate / 10, hours);
+  }
+}
@@ -0,0 +1,25 @@
+/*
+ * Pebble Term Watch
+ *
+ * Battery history.
+ * Persistent ring of delta encoded (minutes, percent) samples, used to
+ * estimate the drain rate of the current discharge.
+ */
+#pragma once
+
+#include <pebble.h>
+
+#define BATTERY_LOG_SIZE (48)
+#define BATTERY_LOG_MIN_MINUTES (60)
+
+void battery_log_load(uint32_t key);
+
+// Appends a sample when the percentage or charging state changed
+void battery_log_add(time_t now, uint8_t percent, bool charging);
+
+// Drain in tenths of a percent per day over the current discharge,
+// false until it spans a drop and BATTERY_LOG_MIN_MINUTES
+bool battery_log_rate(uint16_t *tenths_per_day, uint16_t *hours_left);
+
+// "4.5%/d 212h", or "n/a" without an estimate
+void battery_log_format(char *buf, size_t size);
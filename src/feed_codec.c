@@ -0,0 +1,60 @@
+/*
+ * Pebble Term Watch
+ *
+ * Packed headline decoder.
+ */
+#include <pebble.h>
+#include "feed_codec.h"
+
+// Keep in sync with Codec.DICT in pebble-js-app.js
+static const char *const FEED_CODEC_DICT[FEED_CODEC_DICT_SIZE] = {
+  " the ", " and ", " for ", " with ", " from ", " after ", " says ", " new ",
+  " of ", " to ", " in ", " on ", " is ", " at ", " a ", "'s ",
+  "tion", "ing ", "ed ", "er ", "es ", "re", "th", "an",
+  "Apple", "Google", "Microsoft", "Android", "iPhone", "update", "release", "security"
+};
+
+static size_t feed_unpack_put(char *out, size_t pos, size_t size, const char *text) {
+  while (*text != '\0' && pos < size - 1) {
+    out[pos++] = *text++;
+  }
+  return pos;
+}
+
+size_t feed_unpack(const uint8_t *data, size_t length, char *out, size_t size) {
+  uint16_t bits = 0;
+  uint8_t nbits = 0;
+  size_t pos = 0;
+  char literal[2] = { 0, 0 };
+
+  if (size == 0) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < length && pos < size - 1; i++) {
+    bits = (bits << 8) | data[i];
+    nbits += 8;
+
+    while (nbits >= FEED_CODEC_SYMBOL_BITS && pos < size - 1) {
+      nbits -= FEED_CODEC_SYMBOL_BITS;
+      uint8_t symbol = (bits >> nbits) & 0x7F;
+
+      if (symbol == 0x00) {
+        out[pos] = '\0';
+        return pos;
+      }
+
+      if (symbol < 0x20) {
+        pos = feed_unpack_put(out, pos, size, FEED_CODEC_DICT[symbol - 1]);
+      } else if (symbol == 0x7F) {
+        pos = feed_unpack_put(out, pos, size, FEED_CODEC_DICT[FEED_CODEC_DICT_SIZE - 1]);
+      } else {
+        literal[0] = (char)symbol;
+        pos = feed_unpack_put(out, pos, size, literal);
+      }
+    }
+  }
+
+  out[pos] = '\0';
+  return pos;
+}
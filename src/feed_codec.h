@@ -0,0 +1,20 @@
+/*
+ * Pebble Term Watch
+ *
+ * Packed headline encoding (see Codec in pebble-js-app.js).
+ *
+ * A headline is a stream of 7 bit symbols, packed MSB first:
+ *   0x00        end of stream (also fills the last partial byte)
+ *   0x01 - 0x1F dictionary token 0 - 30
+ *   0x20 - 0x7E literal ASCII character
+ *   0x7F        dictionary token 31
+ */
+#pragma once
+
+#include <pebble.h>
+
+#define FEED_CODEC_SYMBOL_BITS (7)
+#define FEED_CODEC_DICT_SIZE (32)
+
+// Decodes data into out (always NUL terminated), returns the text length
+size_t feed_unpack(const uint8_t *data, size_t length, char *out, size_t size);
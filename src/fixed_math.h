@@ -0,0 +1,15 @@
+/*
+ * Pebble Term Watch
+ *
+ * Fixed point helper for geometry in draw callbacks, static inline so no
+ * soft-float code is linked; test/host/fixed_math_test.c checks it on
+ * Linux.
+ */
+#pragma once
+
+#include <pebble.h>
+
+// value * num / den, truncated toward zero like an integer cast
+static inline int32_t fx_scale(int32_t value, int32_t num, int32_t den) {
+  return den ? (value * num) / den : 0;
+}
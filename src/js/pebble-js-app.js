@@ -5,11 +5,10 @@
  * https://github.com/polygonplanet/PebbleTermWatch
  */
 
-var SETTINGS_URL = 'http://polygonplanet.github.io/PebbleTermWatch/settings/1.0.5.html';
+var SCRIPT_START = Date.now();
 
-var MSG_TYPE_PING = 0;
-var MSG_TYPE_FEED_READY = 1;
-var MSG_TYPE_FEED_TITLE = 2;
+// MSG_TYPE_* and encodeMessage come from message_keys.js, SETTINGS_URL
+// (the settings page as a data: URI) from settings_page.js (generated)
 
 
 (function(global, exports, require) {
@@ -20,24 +19,83 @@ var Feed = require('feed');
 var PebbleTerm = require('pebbleterm');
 var AppMessage = require('appmessage');
 var Lifecycle = require('lifecycle');
+var Trace = require('trace');
+var Seen = require('seen');
+var Codec = require('codec');
+var Outbox = require('outbox');
+var Matcher = require('matcher');
+var Stats = require('stats');
+var Timing = require('timing');
 var util = require('util');
 
-var store, feed, lifecycle;
+var store, feed, lifecycle, seen, outbox;
 
 
 util.mixin(PebbleTerm, {
   cleared: false,
-  AppMessage: AppMessage
+  AppMessage: AppMessage,
+  // date +FORMAT for a watch line (see term_format.h), or def: the
+  // command and its output each fit on the line
+  FORMAT_MAX_LEN: 4,
+  FORMAT_MAX_WIDTH: 16,
+  FORMAT_WIDTHS: {
+    Y: 4, y: 2, m: 2, b: 3, d: 2, e: 2, j: 3, a: 3, u: 1,
+    H: 2, I: 2, p: 2, M: 2, S: 2, s: 10, F: 10, T: 8, R: 5, D: 8, '%': 1
+  },
+  dateFormat: function(v, def) {
+    var format = ('' + (v === void 0 || v === null ? '' : v)).replace(/^\s+|\s+$/g, '');
+    var widths = PebbleTerm.FORMAT_WIDTHS;
+    var width = 0;
+
+    if (format.length > PebbleTerm.FORMAT_MAX_LEN ||
+        !/^(?:[ -$&-~]|%[YymbdejauHIpMSsFTRD%])+$/.test(format)) {
+      return def;
+    }
+
+    format.replace(/%(.)|./g, function(all, c) {
+      width += c ? widths[c] : 1;
+    });
+    return width > PebbleTerm.FORMAT_MAX_WIDTH ? def : format;
+  }
 });
 
 
 util.mixin(AppMessage, {
-  sendStore: function(msg) {
+  sendStore: function(msg, extra, callbacks) {
     store.update(msg);
-    return AppMessage.send.call(this, store.toObject('send'));
+    return AppMessage.send.call(this, util.mixin(store.toObject('send'), extra || {}), callbacks);
+  },
+  onReconnect: function() {
+    // One transfer for everything missed while the link was down
+    var items = outbox.take().filter(function(item) {
+      return item.hash !== seen.watchHash && !seen.has(item.hash);
+    });
+
+    if (items.length && feed) {
+      Stats.count('retransmits');
+      feed.deliver(items[0].title, { priority: items[0].priority });
+
+      var rest = items.slice(1).map(function(item) {
+        return item.title;
+      });
+
+      if (feed.isPull && feed.isPull()) {
+        // The watch shows one at a time, the rest are pulled next. They
+        // are not marked seen, so a later fetch can still bring them.
+        feed.pending = rest.concat(feed.pending);
+      } else if (rest.length) {
+        // Push mode only keeps the newest: the watch shows it until the
+        // next fetch, which replaces anything queued
+        Stats.count('superseded', rest.length);
+      }
+    }
   },
   ping: function() {
-    return AppMessage.sendStore.call(this, { msgType: MSG_TYPE_PING });
+    store.update({ msgType: MSG_TYPE_PING });
+    return AppMessage.post.call(this, store.toObject('send'));
+  },
+  requestTrace: function() {
+    return AppMessage.send.call(this, { msgType: MSG_TYPE_TRACE_DUMP });
   }
 });
 
@@ -77,6 +135,14 @@ lifecycle = PebbleTerm.lifecycle = new Lifecycle('pebbleTermLifecycle', {
 });
 
 
+// Headlines already delivered to the watch
+seen = PebbleTerm.seen = new Seen('pebbleTermSeen');
+
+
+// Headlines the watch did not receive
+outbox = PebbleTerm.outbox = new Outbox('pebbleTermOutbox');
+
+
 // Persist store
 //  - send: Send to pebble
 //  - storage: Store localStorage
@@ -207,6 +273,139 @@ store = PebbleTerm.store = new Store('pebbleTerm', {
       return (v - 0) ? 1 : 0;
     }
   },
+  replayMode: {
+    send: true,
+    storage: true,
+    value: 0,
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      // 0: every minute, 1: every hour, 2: on wrist flick
+      var mode = ~~(v - 0) || 0;
+      return mode >= 0 && mode <= 2 ? mode : 0;
+    }
+  },
+  dateFormat: {
+    send: true,
+    storage: true,
+    value: '%F',
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      return PebbleTerm.dateFormat(v, '%F');
+    }
+  },
+  hourFormat: {
+    send: true,
+    storage: true,
+    value: '%T',
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      return PebbleTerm.dateFormat(v, '%T');
+    }
+  },
+  timeFormat: {
+    send: true,
+    storage: true,
+    value: '%s',
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      return PebbleTerm.dateFormat(v, '%s');
+    }
+  },
+  pullMode: {
+    send: true,
+    storage: true,
+    value: 0,
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      // the watch asks for the next headline after each scroll loop
+      return (v - 0) ? 1 : 0;
+    }
+  },
+  invert: {
+    send: true,
+    storage: true,
+    value: 0,
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      // black on white
+      return (v - 0) ? 1 : 0;
+    }
+  },
+  batteryLine: {
+    send: true,
+    storage: true,
+    value: 0,
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      // pebble>upower instead of the unixtime line
+      return (v - 0) ? 1 : 0;
+    }
+  },
+  includeKeywords: {
+    send: false,
+    storage: true,
+    value: '',
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      // comma separated, case insensitive
+      return '' + (v === void 0 || v === null ? '' : v);
+    }
+  },
+  excludeKeywords: {
+    send: false,
+    storage: true,
+    value: '',
+    get: function() {
+      return this.fix(this.value);
+    },
+    set: function(v) {
+      return (this.value = this.fix(v));
+    },
+    fix: function(v) {
+      // comma separated, case insensitive
+      return '' + (v === void 0 || v === null ? '' : v);
+    }
+  },
   feedInterval: {
     send: false,
     storage: true,
@@ -226,6 +425,11 @@ store = PebbleTerm.store = new Store('pebbleTerm', {
 
 
 var init = function() {
+  // Watch built without the feed (see PROFILES in tools/profiles.py)
+  if (MESSAGE_FEATURES.indexOf('feed') === -1) {
+    return;
+  }
+
   lifecycle.store.load();
   if (lifecycle.isRunning()) {
     return;
@@ -261,6 +465,62 @@ var init = function() {
         lifecycle.store.save();
       }
     },
+    onSkip: function(title, options) {
+      var hash = Seen.hash(title);
+
+      // Never resend a known headline once the watch shows one
+      if (seen.watchHash && seen.has(hash)) {
+        return true;
+      }
+
+      // Replacing a headline is not urgent
+      options.replaces = !!seen.watchHash;
+      return false;
+    },
+    onDelivered: function(title) {
+      // Only what the watch took counts as seen
+      var hash = Seen.hash(title);
+
+      seen.add(hash);
+      seen.watchHash = hash;
+    },
+    onHold: function(title, options) {
+      // in pull mode the watch asked for it and is awake
+      if (!options.replaces || options.priority !== Outbox.HEADLINE ||
+          store.pullMode.get()) {
+        return 0;
+      }
+      return AppMessage.untilWake(Feed.WAKE_LEAD);
+    },
+    onFilter: function(titles) {
+      var include = Matcher.compile(store.includeKeywords.get());
+      var exclude = Matcher.compile(store.excludeKeywords.get());
+
+      return titles.filter(function(title) {
+        var text = Matcher.normalize(title);
+
+        if ((include.empty || include.test(text)) && !exclude.test(text)) {
+          return true;
+        }
+        Stats.count('filtered');
+        return false;
+      });
+    },
+    onNext: function() {
+      // Refresh no faster than the interval, however fast the watch reads
+      lifecycle.store.load();
+      store.load();
+      return Math.max(0, lifecycle.store.fetchTime.get() +
+                         store.feedInterval.get() * 1000 - Date.now());
+    },
+    isPull: function() {
+      return !!store.pullMode.get();
+    },
+    onUndelivered: function(title, options) {
+      // The watch still shows whatever it had; FEED_READY will tell
+      seen.watchHash = null;
+      outbox.push(title, options.priority || Outbox.ERROR);
+    },
     onRefetchStart: function() {
       this.refetchTime = this.pingTime = Date.now();
     },
@@ -280,7 +540,9 @@ var init = function() {
         return true;
       }
 
-      if (t - this.pingTime > Feed.PING_INTERVAL) {
+      // a sleeping watch is only pinged as it wakes for its minute tick
+      if (t - this.pingTime > Feed.PING_INTERVAL &&
+          !AppMessage.untilWake(AppMessage.WAKE_SLACK)) {
         this.pingTime = t;
         AppMessage.ping();
       }
@@ -313,11 +575,15 @@ var init = function() {
 Pebble.addEventListener('ready', function(ev) {
   store.load();
   AppMessage.ping();
-  init();
+
+  // Feed machinery after the first message is out
+  setTimeout(init, 0);
 });
 
 Pebble.addEventListener('showConfiguration', function(ev) {
-  var url = store.toURI(SETTINGS_URL);
+  // Fetch pipeline timings ride along for the settings page
+  Timing.save(true);
+  var url = store.toURI(SETTINGS_URL, { timing: Timing.encode() });
   Pebble.openURL(url);
 });
 
@@ -329,27 +595,67 @@ Pebble.addEventListener('webviewclosed', function(ev) {
     }
 
     var prevUrl = store.feedUrl.get();
+    var prevPull = store.pullMode.get();
 
-    store.fromJSON(ev.response);
+    // the bundled page sends encoded JSON
+    var response = /^%7B/i.test(ev.response) ?
+                   decodeURIComponent(ev.response) : ev.response;
+
+    store.fromJSON(response);
     store.save();
 
     var newUrl = store.feedUrl.get();
 
     if (feed && feed.url && newUrl && prevUrl !== newUrl) {
       init();
+    } else if (feed && prevPull && !store.pullMode.get() && !feed.fetching) {
+      // back to the phone's own schedule
+      feed.refetch();
     }
 
     AppMessage.ping();
+
+    // a one-off from the settings page, never stored
+    if (JSON.parse(response).dumpTrace) {
+      AppMessage.requestTrace();
+    }
   }
 });
 
 Pebble.addEventListener('appmessage', function(e) {
   if (e.payload) {
+    if (e.payload.trace) {
+      Trace.collect(e.payload.trace);
+      return;
+    }
+
+    if (e.payload.nextWake !== void 0) {
+      AppMessage.wake(e.payload.nextWake);
+    }
+
+    if (e.payload.msgType === MSG_TYPE_FEED_READY ||
+        e.payload.msgType === MSG_TYPE_FEED_NEXT) {
+      // Headline currently shown on the watch (0: none)
+      seen.watchHash = (e.payload.feedHash >>> 0) || null;
+    }
+
+    // The watch sends FEED_READY again when bluetooth comes back
+    if (AppMessage.offline || e.payload.msgType === MSG_TYPE_FEED_READY) {
+      AppMessage.online();
+    }
+
     switch (e.payload.msgType) {
       case MSG_TYPE_PING:
         break;
       case MSG_TYPE_FEED_READY:
         break;
+      case MSG_TYPE_FEED_NEXT:
+        if (feed) {
+          // the headline is the answer, no ping
+          feed.next();
+          return;
+        }
+        break;
     }
 
     // Response all of messages
@@ -364,7 +670,11 @@ Pebble.addEventListener('appmessage', function(e) {
 }).apply(this, (function(global, exports, require) {
 
 
-var Promise = require('promise');
+// The Promise polyfill is evaluated on first construction
+var Promise = function(resolver) {
+  Promise = require('promise');
+  return new Promise(resolver);
+};
 
 var PebbleTerm = exports.PebbleTerm = {};
 
@@ -433,13 +743,16 @@ Store.prototype = {
       });
     }
   },
-  toURI: function(url) {
-    var data = this.toObject('storage');
+  toURI: function(url, extra) {
+    var data = mixin(this.toObject('storage'), extra || {});
+
+    // a data: URI has no query, the page reads the fragment
+    var separator = /^data:/.test(url) ? '#' : '?';
 
     return Object.keys(data).reduce(function(uri, key) {
       return (uri += encodeURIComponent(key) + '=' +
                      encodeURIComponent(data[key]) + '&');
-    }, url + '?').slice(0, -1);
+    }, url + separator).slice(0, -1);
   },
   fromURI: function(uri) {
     this.fromJSON(decodeURIComponent(uri));
@@ -454,9 +767,11 @@ Store.prototype = {
     }
   },
   save: function() {
+    Stats.count('storageWrites');
     window.localStorage.setItem(this._key, this.toJSON('storage'));
   },
   load: function() {
+    Stats.count('storageReads');
     var data = window.localStorage.getItem(this._key);
 
     if (!data) {
@@ -515,7 +830,538 @@ var Lifecycle = exports.Lifecycle = function(name, store) {
     id: {
       send: false,
       storage: true,
-      value: '',
+      value: '',
+      get: function() {
+        return this.fix(this.value);
+      },
+      set: function(v) {
+        return (this.value = this.fix(v));
+      },
+      fix: function(v) {
+        return v;
+      }
+    }
+  }));
+};
+
+Lifecycle.prototype = {
+  // Checks whether is running last process
+  // false: not running
+  isRunning: function() {
+    this.store.load();
+
+    var id = this.store.id.get();
+    if (!id) {
+      return false;
+    }
+
+    var time = this.store.time.get();
+    if (!time) {
+      return false;
+    }
+
+    return Date.now() - time < 8000;
+  },
+  update: function() {
+    this.store.time.update();
+    this.store.id.set(this.id);
+    this.store.save();
+  },
+  _ticking: false,
+  startTick: function() {
+    if (this._ticking) {
+      return;
+    }
+    this._ticking = true;
+
+    var self = this;
+
+    (function next() {
+      self.update();
+
+      if (self._ticking) {
+        Stats.count('timers');
+        setTimeout(next, 2500);
+      }
+    }());
+  },
+  stopTick: function() {
+    this._ticking = false;
+  }
+};
+
+
+// App Message utility
+var AppMessage = exports.AppMessage = {
+  offline: false,
+  inflight: 0,
+  // consecutive nacks; a single one is usually APP_MSG_BUSY, not a dead link
+  nacks: 0,
+  OFFLINE_NACKS: 3,
+  // Next minute tick of the watch (ms), from nextWake in its messages;
+  // null while the watch wakes every second anyway
+  wakeAt: null,
+  WAKE_PERIOD: 60 * 1000,
+  // a message this close before the tick shares its wakeup
+  WAKE_SLACK: 3 * 1000,
+  // callbacks.ack / callbacks.nack: the watch took / did not take msg.
+  // Returns false if another sender holds the lock. No Promise, so a
+  // ping at 'ready' does not load the polyfill.
+  post: function(msg, callbacks) {
+    var context = this;
+
+    callbacks = callbacks || {};
+
+    var locked = AppMessage.locked;
+
+    if (locked && context && context.locked === locked) {
+      locked = false;
+    }
+
+    if (locked) {
+      return false;
+    }
+
+    // script start to the first message, recorded once it is out
+    var ready = AppMessage.sent ? -1 : Date.now() - SCRIPT_START;
+
+    AppMessage.sent = true;
+
+    var data = encodeMessage(msg);
+    // only headlines are a pipeline stage, pings would swamp the buckets
+    var acked = msg.msgType === MSG_TYPE_FEED_TITLE ? Timing.start('send') : null;
+
+    Stats.count('messages');
+    Stats.count('bytes', AppMessage.size(data));
+
+    if (AppMessage.untilWake(AppMessage.WAKE_SLACK)) {
+      // lands between two watch ticks
+      Stats.count('extraWakes');
+    }
+
+    if (msg.msgType === MSG_TYPE_PING && !msg.feedTitle) {
+      Stats.count('pings');
+      if (AppMessage.inflight) {
+        // the pending message already answers whether the link is up
+        Stats.count('wastedPings');
+      }
+    }
+    AppMessage.inflight++;
+
+    Pebble.sendAppMessage(data, function() {
+      AppMessage.inflight--;
+      if (acked) {
+        acked();
+      }
+      if (AppMessage.offline || AppMessage.nacks) {
+        // answering again, resend what it missed
+        AppMessage.online();
+      }
+      if (callbacks.ack) {
+        callbacks.ack();
+      }
+    }, function() {
+      AppMessage.inflight--;
+      Timing.count('nacks');
+      if (++AppMessage.nacks >= AppMessage.OFFLINE_NACKS) {
+        AppMessage.offline = true;
+      }
+      if (callbacks.nack) {
+        callbacks.nack();
+      }
+    });
+
+    if (ready !== -1) {
+      Timing.record('ready', ready);
+    }
+    return true;
+  },
+  send: function(msg, callbacks) {
+    var context = this;
+
+    return new Promise(function(resolve) {
+      AppMessage.post.call(context, msg, callbacks);
+      resolve();
+    });
+  },
+  // Dictionary bytes on the wire (same layout as tools/message_keys.py)
+  size: function(data) {
+    return Object.keys(data).reduce(function(size, key) {
+      var value = data[key];
+
+      if (typeof value === 'number') {
+        return size + 7 + 4;
+      }
+      return size + 7 + (Array.isArray(value) ? value.length : ('' + value).length + 1);
+    }, 1);
+  },
+  wake: function(seconds) {
+    AppMessage.wakeAt = seconds > 0 ? Date.now() + seconds * 1000 : null;
+  },
+  // ms until lead before the next watch tick, 0 when unknown or due
+  untilWake: function(lead) {
+    var at = AppMessage.wakeAt;
+    var now = Date.now();
+
+    if (!at) {
+      return 0;
+    }
+
+    while (at < now) {
+      at += AppMessage.WAKE_PERIOD;
+    }
+    return Math.max(0, at - lead - now);
+  },
+  online: function() {
+    AppMessage.offline = false;
+    AppMessage.nacks = 0;
+    if (AppMessage.onReconnect) {
+      AppMessage.onReconnect();
+    }
+  },
+  lock: (function() {
+    var ids = Object.create(null);
+    var genid = function() {
+      var id = Math.random().toString(36).slice(1);
+      return (id in ids) ? genid() : (ids[id] = null, id);
+    };
+
+    return function() {
+      if (AppMessage.locked) {
+        return false;
+      }
+
+      return (AppMessage.locked = genid());
+    };
+  }()),
+  unlock: function(id) {
+    if (!AppMessage.locked) {
+      return true;
+    }
+
+    if (AppMessage.locked === id) {
+      delete AppMessage.locked;
+      return true;
+    }
+
+    return false;
+  }
+};
+
+
+// Runtime counters, read by the harness (test/js/hour.js)
+var Stats = exports.Stats = {
+  counters: {
+    fetches: 0,
+    cpu: 0,
+    messages: 0,
+    bytes: 0,
+    pings: 0,
+    wastedPings: 0,
+    retransmits: 0,
+    superseded: 0,
+    extraWakes: 0,
+    held: 0,
+    filtered: 0,
+    packedSaved: 0,
+    storageReads: 0,
+    storageWrites: 0,
+    timers: 0
+  },
+  count: function(name, n) {
+    this.counters[name] = (this.counters[name] || 0) + (n === void 0 ? 1 : n);
+  },
+  // Runs fn and adds its synchronous run time (ms) to 'cpu'
+  measure: function(fn, context) {
+    var time = Date.now();
+
+    try {
+      return fn.call(context);
+    } finally {
+      this.count('cpu', Date.now() - time);
+    }
+  },
+  report: function() {
+    var counters = this.counters;
+
+    return Object.keys(counters).map(function(name) {
+      return name + '=' + counters[name];
+    }).join(' ');
+  }
+};
+
+
+// Fetch pipeline stage timings as fixed bucket histograms
+//  - bucket i counts durations <= BOUNDS[i] ms (the last one is open)
+//  - ready: script start to the first message, once per launch
+var Timing = exports.Timing = {
+  BOUNDS: [10, 50, 100, 500, 1000, 5000, Infinity],
+  STAGES: ['ready', 'request', 'parse', 'format', 'lock', 'send', 'total'],
+  COUNTERS: ['errors', 'retries', 'nacks'],
+  SAVE_INTERVAL: 5 * 60 * 1000,
+  NAME: 'pebbleTermTiming',
+  _store: null,
+  _saveTime: 0,
+  store: function() {
+    if (!this._store) {
+      this._store = new Store(this.NAME, {
+        data: {
+          send: false,
+          storage: true,
+          value: {},
+          get: function() {
+            return this.fix(this.value);
+          },
+          set: function(v) {
+            return (this.value = this.fix(v));
+          },
+          fix: function(v) {
+            var data = v && typeof v === 'object' ? v : {};
+            var size = Timing.BOUNDS.length;
+
+            Timing.STAGES.forEach(function(stage) {
+              var hist = Array.isArray(data[stage]) ? data[stage] : [];
+
+              data[stage] = hist.slice(0, size);
+              for (var i = 0; i < size; i++) {
+                data[stage][i] = data[stage][i] - 0 || 0;
+              }
+            });
+            Timing.COUNTERS.forEach(function(name) {
+              data[name] = data[name] - 0 || 0;
+            });
+            return data;
+          }
+        }
+      });
+      this._store.load();
+      this._saveTime = Date.now();
+    }
+    return this._store;
+  },
+  data: function() {
+    return this.store().data.get();
+  },
+  record: function(stage, ms) {
+    var hist = this.data()[stage];
+    var i = 0;
+
+    while (ms > this.BOUNDS[i]) {
+      i++;
+    }
+    hist[i]++;
+    this.save();
+  },
+  count: function(name) {
+    this.data()[name]++;
+    this.save();
+  },
+  // Runs fn (through Stats.measure) and records its run time
+  measure: function(stage, fn, context) {
+    var time = Date.now();
+
+    try {
+      return Stats.measure(fn, context);
+    } finally {
+      this.record(stage, Date.now() - time);
+    }
+  },
+  // Returns a function recording the time elapsed since start()
+  start: function(stage) {
+    var self = this;
+    var time = Date.now();
+
+    return function() {
+      self.record(stage, Date.now() - time);
+    };
+  },
+  save: function(force) {
+    if (force || Date.now() - this._saveTime > this.SAVE_INTERVAL) {
+      this._saveTime = Date.now();
+      this.store().save();
+    }
+  },
+  // Upper bucket bound (ms) holding the q quantile of stage
+  quantile: function(stage, q) {
+    var hist = this.data()[stage];
+    var total = hist.reduce(function(a, b) {
+      return a + b;
+    }, 0);
+    var n = 0;
+
+    if (!total) {
+      return 0;
+    }
+
+    for (var i = 0; i < hist.length; i++) {
+      n += hist[i];
+      if (n >= total * q) {
+        return this.BOUNDS[i];
+      }
+    }
+    return Infinity;
+  },
+  // "request:0.4.2.1.0.0.0~parse:...~errors:1~..."
+  encode: function() {
+    var data = this.data();
+
+    return this.STAGES.map(function(stage) {
+      return stage + ':' + data[stage].join('.');
+    }).concat(this.COUNTERS.map(function(name) {
+      return name + ':' + data[name];
+    })).join('~');
+  },
+  // One line summary: p50/p90 upper bounds per stage
+  report: function() {
+    var self = this;
+    var data = this.data();
+    var bound = function(ms) {
+      return ms === Infinity ? '>' + self.BOUNDS[self.BOUNDS.length - 2] : ms;
+    };
+
+    return this.STAGES.map(function(stage) {
+      return stage + '=' + bound(self.quantile(stage, 0.5)) + '/' +
+             bound(self.quantile(stage, 0.9));
+    }).concat(this.COUNTERS.map(function(name) {
+      return name + '=' + data[name];
+    })).join(' ');
+  }
+};
+
+// Kept by store.clear() even before the first measurement
+Store.registerName(Timing.NAME);
+
+
+// Watch event trace decoder (see term_trace.c)
+var Trace = exports.Trace = {
+  RECORD_SIZE: 5,
+  EVENTS: [
+    'none', 'tick', 'timer', 'feed_end', 'tuple',
+    'battery', 'bluetooth', 'send', 'reset'
+  ],
+  RESULTS: [
+    'APP_MSG_OK', 'APP_MSG_SEND_TIMEOUT', 'APP_MSG_SEND_REJECTED',
+    'APP_MSG_NOT_CONNECTED', 'APP_MSG_APP_NOT_RUNNING',
+    'APP_MSG_INVALID_ARGS', 'APP_MSG_BUSY', 'APP_MSG_BUFFER_OVERFLOW',
+    '', 'APP_MSG_ALREADY_RELEASED', 'APP_MSG_CALLBACK_ALREADY_REGISTERED',
+    'APP_MSG_CALLBACK_NOT_REGISTERED', 'APP_MSG_OUT_OF_MEMORY',
+    'APP_MSG_CLOSED', 'APP_MSG_INTERNAL_ERROR'
+  ],
+  chunks: [],
+  collect: function(chunk) {
+    var index = chunk[0];
+    var count = chunk[1];
+
+    if (index === 0) {
+      this.chunks = [];
+    }
+    this.chunks[index] = chunk.slice(2);
+
+    if (index === count - 1) {
+      this.decode([].concat.apply([], this.chunks)).forEach(function(line) {
+        console.log('trace: ' + line);
+      });
+      this.chunks = [];
+    }
+  },
+  decode: function(bytes) {
+    var lines = [];
+    var time = 0;
+
+    for (var i = 0; i + this.RECORD_SIZE <= bytes.length; i += this.RECORD_SIZE) {
+      var dt = bytes[i] | (bytes[i + 1] << 8);
+      var type = this.EVENTS[bytes[i + 2]] || ('#' + bytes[i + 2]);
+      var arg = bytes[i + 3];
+      var len = bytes[i + 4];
+
+      time += dt;
+
+      if (type === 'send') {
+        len = len ? this.RESULTS[len - 1] || len : this.RESULTS[0];
+      }
+      lines.push('+' + time + 'ms ' + type + ' ' + arg + ' ' + len);
+    }
+    return lines;
+  }
+};
+
+
+// Fingerprints of delivered headlines, most recent first
+// (same hash as feed_title_hash in pebble_term_watch.c)
+var Seen = exports.Seen = function(name) {
+  this.watchHash = null;
+  this.store = new Store(name, {
+    hashes: {
+      send: false,
+      storage: true,
+      value: [],
+      get: function() {
+        return this.fix(this.value);
+      },
+      set: function(v) {
+        return (this.value = this.fix(v));
+      },
+      fix: function(v) {
+        return Array.isArray(v) ? v.slice(0, Seen.MAX) : [];
+      }
+    }
+  });
+};
+
+Seen.MAX = 32;
+Seen.HASH_LEN = 96;
+Seen.CACHE_PREFIX = 'cache: ';
+
+// FNV-1a (32bit)
+Seen.hash = function(title) {
+  var hash = 0x811c9dc5;
+
+  title = '' + title;
+  if (title.indexOf(Seen.CACHE_PREFIX) === 0) {
+    title = title.slice(Seen.CACHE_PREFIX.length);
+  }
+
+  for (var i = 0, len = Math.min(title.length, Seen.HASH_LEN); i < len; i++) {
+    hash ^= title.charCodeAt(i) & 0xff;
+    hash += (hash << 1) + (hash << 4) + (hash << 7) + (hash << 8) + (hash << 24);
+  }
+  return hash >>> 0;
+};
+
+Seen.prototype = {
+  has: function(hash) {
+    this.store.load();
+    return this.store.hashes.get().indexOf(hash) !== -1;
+  },
+  add: function(hash) {
+    this.store.load();
+
+    var hashes = this.store.hashes.get();
+    var index = hashes.indexOf(hash);
+
+    if (index === 0) {
+      return false;
+    }
+    if (index !== -1) {
+      hashes.splice(index, 1);
+    }
+
+    hashes.unshift(hash);
+    this.store.hashes.set(hashes);
+    this.store.save();
+
+    return index === -1;
+  }
+};
+
+
+// Bounded queue of undelivered headlines, one entry per hash
+var Outbox = exports.Outbox = function(name) {
+  this.store = new Store(name, {
+    items: {
+      send: false,
+      storage: true,
+      value: [],
       get: function() {
         return this.fix(this.value);
       },
@@ -523,105 +1369,255 @@ var Lifecycle = exports.Lifecycle = function(name, store) {
         return (this.value = this.fix(v));
       },
       fix: function(v) {
-        return v;
+        return Array.isArray(v) ? v.slice(0, Outbox.MAX) : [];
       }
     }
-  }));
+  });
 };
 
-Lifecycle.prototype = {
-  // Checks whether is running last process
-  // false: not running
-  isRunning: function() {
+Outbox.MAX = 8;
+
+// priorities
+Outbox.ERROR = 0;
+Outbox.CACHE = 1;
+Outbox.HEADLINE = 2;
+
+// expiry (ms) by priority
+Outbox.TTL = [2 * 60 * 1000, 5 * 60 * 1000, 30 * 60 * 1000];
+
+Outbox.prototype = {
+  push: function(title, priority) {
+    var hash = Seen.hash(title);
+
     this.store.load();
 
-    var id = this.store.id.get();
-    if (!id) {
-      return false;
-    }
+    var items = this.store.items.get().filter(function(item) {
+      return item.hash !== hash;
+    });
 
-    var time = this.store.time.get();
-    if (!time) {
-      return false;
+    items.unshift({
+      title: title,
+      hash: hash,
+      priority: priority,
+      time: Date.now()
+    });
+    this.store.items.set(items);
+    this.store.save();
+  },
+  // Empties the queue, returns live items by priority then newest first
+  take: function() {
+    var now = Date.now();
+
+    this.store.load();
+
+    var items = this.store.items.get();
+    if (!items.length) {
+      return items;
     }
 
-    return Date.now() - time < 8000;
-  },
-  update: function() {
-    this.store.time.update();
-    this.store.id.set(this.id);
+    this.store.items.set([]);
     this.store.save();
-  },
-  _ticking: false,
-  startTick: function() {
-    if (this._ticking) {
-      return;
+
+    return items.filter(function(item) {
+      return now - item.time < (Outbox.TTL[item.priority] || Outbox.TTL[0]);
+    }).sort(function(a, b) {
+      return (b.priority - a.priority) || (b.time - a.time);
+    });
+  }
+};
+
+
+// Multi keyword matcher (Aho-Corasick), one pass over the text
+// whatever the number of keywords
+var Matcher = exports.Matcher = function(words) {
+  this.next = [Object.create(null)];
+  this.fail = [0];
+  this.out = [false];
+  this.empty = words.length === 0;
+
+  words.forEach(this.add, this);
+  this.build();
+};
+
+// Lower case ASCII, the form keywords and titles are compared in
+Matcher.normalize = function(s) {
+  s = '' + s;
+  if (/[^\x00-\x7f]/.test(s)) {
+    s = toAscii(s);
+  }
+  return s.toLowerCase();
+};
+
+// Compiled matchers of the lists in use (include and exclude), most
+// recent first; a settings change drops the old ones
+Matcher.CACHE_MAX = 2;
+Matcher._cache = [];
+
+Matcher.compile = function(list) {
+  list = '' + (list || '');
+
+  var cache = Matcher._cache;
+
+  for (var i = 0; i < cache.length; i++) {
+    if (cache[i].list === list) {
+      return cache[i].matcher;
     }
-    this._ticking = true;
+  }
 
-    var self = this;
+  var words = list.split(/[,\n]/).map(function(word) {
+    return Matcher.normalize(word).replace(/^\s+|\s+$/g, '');
+  }).filter(Boolean);
+  var matcher = new Matcher(words);
 
-    (function next() {
-      self.update();
+  cache.unshift({ list: list, matcher: matcher });
+  cache.length = Math.min(cache.length, Matcher.CACHE_MAX);
+  return matcher;
+};
 
-      if (self._ticking) {
-        setTimeout(next, 2500);
+Matcher.prototype = {
+  add: function(word) {
+    var state = 0;
+
+    for (var i = 0; i < word.length; i++) {
+      var c = word.charAt(i);
+
+      if (!(c in this.next[state])) {
+        this.next[state][c] = this.next.length;
+        this.next.push(Object.create(null));
+        this.fail.push(0);
+        this.out.push(false);
       }
-    }());
+      state = this.next[state][c];
+    }
+    this.out[state] = true;
   },
-  stopTick: function() {
-    this._ticking = false;
-  }
-};
+  // Failure links, breadth first
+  build: function() {
+    var queue = [0];
 
+    while (queue.length) {
+      var u = queue.shift();
 
-// App Message utility
-var AppMessage = exports.AppMessage = {
-  send: function(msg) {
-    var context = this;
+      Object.keys(this.next[u]).forEach(function(c) {
+        var v = this.next[u][c];
+        var f = this.fail[u];
 
-    return new Promise(function(resolve, reject) {
-      var locked = AppMessage.locked;
+        if (u !== 0) {
+          while (f && !(c in this.next[f])) {
+            f = this.fail[f];
+          }
+          this.fail[v] = (c in this.next[f]) ? this.next[f][c] : 0;
+          this.out[v] = this.out[v] || this.out[this.fail[v]];
+        }
+        queue.push(v);
+      }, this);
+    }
+  },
+  test: function(text) {
+    var state = 0;
 
-      if (locked && context && context.locked === locked) {
-        locked = false;
+    for (var i = 0; i < text.length; i++) {
+      var c = text.charAt(i);
+
+      while (state && !(c in this.next[state])) {
+        state = this.fail[state];
       }
+      state = this.next[state][c] || 0;
 
-      if (locked) {
-        resolve();
-        return;
+      if (this.out[state]) {
+        return true;
       }
+    }
+    return false;
+  }
+};
 
-      Pebble.sendAppMessage(msg);
-      resolve();
-    });
+
+// Packed headline encoding (see feed_codec.h)
+var Codec = exports.Codec = {
+  // Keep in sync with FEED_CODEC_DICT in feed_codec.c
+  DICT: [
+    ' the ', ' and ', ' for ', ' with ', ' from ', ' after ', ' says ', ' new ',
+    ' of ', ' to ', ' in ', ' on ', ' is ', ' at ', ' a ', '\'s ',
+    'tion', 'ing ', 'ed ', 'er ', 'es ', 're', 'th', 'an',
+    'Apple', 'Google', 'Microsoft', 'Android', 'iPhone', 'update', 'release', 'security'
+  ],
+  symbol: function(index) {
+    return index < 31 ? index + 1 : 0x7f;
   },
-  lock: (function() {
-    var ids = Object.create(null);
-    var genid = function() {
-      var id = Math.random().toString(36).slice(1);
-      return (id in ids) ? genid() : (ids[id] = null, id);
-    };
+  // Returns a byte array, or null if s is not printable ASCII
+  pack: function(s) {
+    var symbols = [];
+    var i = 0, j, len = s.length, code, best, word;
+
+    while (i < len) {
+      best = -1;
+
+      for (j = 0; j < this.DICT.length; j++) {
+        word = this.DICT[j];
+        if ((best === -1 || word.length > this.DICT[best].length) &&
+            s.substr(i, word.length) === word) {
+          best = j;
+        }
+      }
 
-    return function() {
-      if (AppMessage.locked) {
-        return false;
+      if (best !== -1) {
+        symbols.push(this.symbol(best));
+        i += this.DICT[best].length;
+        continue;
       }
 
-      return (AppMessage.locked = genid());
-    };
-  }()),
-  unlock: function(id) {
-    if (!AppMessage.locked) {
-      return true;
+      code = s.charCodeAt(i++);
+      if (code < 0x20 || code > 0x7e) {
+        return null;
+      }
+      symbols.push(code);
     }
 
-    if (AppMessage.locked === id) {
-      delete AppMessage.locked;
-      return true;
+    var bytes = [];
+    var bits = 0, nbits = 0;
+
+    symbols.forEach(function(symbol) {
+      bits = ((bits << 7) | symbol) & 0x7fff;
+      nbits += 7;
+
+      if (nbits >= 8) {
+        nbits -= 8;
+        bytes.push((bits >> nbits) & 0xff);
+      }
+    });
+
+    if (nbits > 0) {
+      // pad with zero bits (end of stream)
+      bytes.push((bits << (8 - nbits)) & 0xff);
     }
+    return bytes;
+  },
+  unpack: function(bytes) {
+    var s = '';
+    var bits = 0, nbits = 0, symbol;
 
-    return false;
+    for (var i = 0; i < bytes.length; i++) {
+      bits = ((bits << 8) | bytes[i]) & 0x7fff;
+      nbits += 8;
+
+      while (nbits >= 7) {
+        nbits -= 7;
+        symbol = (bits >> nbits) & 0x7f;
+
+        if (symbol === 0) {
+          return s;
+        }
+        if (symbol < 0x20) {
+          s += this.DICT[symbol - 1];
+        } else if (symbol === 0x7f) {
+          s += this.DICT[31];
+        } else {
+          s += String.fromCharCode(symbol);
+        }
+      }
+    }
+    return s;
   }
 };
 
@@ -633,10 +1629,18 @@ var Feed = exports.Feed = function(url) {
 
 Feed.WAIT_INTERVAL = 1000;
 Feed.PING_INTERVAL = 10 * 1000;
+// Held headlines reach the watch this long before its minute tick
+// (covers the 1s delay in deliver and the link)
+Feed.WAKE_LEAD = 2 * 1000;
 Feed.CACHE_INTERVAL = 1 * 60 * 1000;
 Feed.TITLE_MAX_LEN = 120;
 Feed.TITLE_CHUNK_MAX_LEN = 17;
 
+// Proxy titles that are already printable ASCII and short enough
+Feed.isNormalized = function(title) {
+  return title.length < Feed.TITLE_MAX_LEN && !/[^\x20-\x7e]/.test(title);
+};
+
 Feed.prototype = {
   init: function(url) {
     this.url = url;
@@ -645,22 +1649,42 @@ Feed.prototype = {
     this.locked = null;
     this.cache = null;
     this.useCache = false;
+    this.failed = false;
+    this.fetchDone = null;
+    this.compact = false;
+    this.etag = null;
+    this.pending = [];
+    this.nextWaiting = false;
   },
+  // Returns every item title, in feed order
   parse: function(res) {
-    var doc = new DOMParser().parseFromString(res, 'text/xml');
-    var items = doc.getElementsByTagName('item');
+    var items;
 
-    if (items.length === 0) {
-      return 'No item';
-    }
+    // Compact list from a feed proxy (tools/feed_proxy.py)
+    this.compact = /^\s*\{/.test(res);
 
-    var title = items[0].getElementsByTagName('title');
+    if (this.compact) {
+      var list = JSON.parse(res);
 
-    if (title.length === 0) {
-      return 'No title';
+      items = list && Array.isArray(list.items) ? list.items : [];
+      return items.map(function(item) {
+        return '' + item;
+      });
     }
 
-    return title[0].textContent;
+    var doc = new DOMParser().parseFromString(res, 'text/xml');
+    var titles = [];
+
+    items = doc.getElementsByTagName('item');
+
+    for (var i = 0; i < items.length; i++) {
+      var title = items[i].getElementsByTagName('title');
+
+      if (title.length) {
+        titles.push(title[0].textContent);
+      }
+    }
+    return titles;
   },
   clear: function() {
     PebbleTerm.store.update({
@@ -714,11 +1738,13 @@ Feed.prototype = {
   },
   lockMsg: function() {
     var self = this;
+    var done = Timing.start('lock');
 
     return new Promise(function(resolve) {
       till(function() {
         return !!(self.locked = PebbleTerm.AppMessage.lock());
       }).then(function() {
+        done();
         resolve();
       });
     });
@@ -745,39 +1771,136 @@ Feed.prototype = {
       this.onSend.call(this, title, options);
     }
 
-    title = this.format(title);
+    if (!options.normalized || !Feed.isNormalized(title)) {
+      title = Timing.measure('format', function() {
+        return this.format(title);
+      }, this);
+    }
+
+    var finish = function() {
+      self.fetching = false;
+      if (options.refetch) {
+        self.refetch();
+      }
+    };
+
+    if (this.onSkip && this.onSkip.call(this, title, options)) {
+      finish();
+      return false;
+    }
+
+    if (PebbleTerm.AppMessage.offline) {
+      // Hold it for reconnect instead of pushing into a dead link
+      if (this.onUndelivered) {
+        this.onUndelivered.call(this, title, options);
+      }
+      finish();
+      return false;
+    }
+
+    this.deliver(title, options).then(finish);
+    return true;
+  },
+  // Pull mode: the watch finished a scroll loop and has room for one more
+  next: function() {
+    var self = this;
+
+    if (this.fetching) {
+      return;
+    }
+
+    while (this.pending.length) {
+      this.fetching = true;
+
+      if (this.sendTitle(this.pending.shift(), {
+        normalized: this.compact,
+        priority: Outbox.HEADLINE
+      })) {
+        return;
+      }
+    }
+
+    // every headline of the last fetch has been read; the watch waits
+    // for an answer, so the fetch is put off rather than dropped
+    var wait = this.onNext ? this.onNext.call(this) : 0;
+
+    if (!wait) {
+      this.fetch();
+    } else if (!this.nextWaiting) {
+      this.nextWaiting = true;
+      delay(wait).then(function() {
+        self.nextWaiting = false;
+        if (!self.isPull || self.isPull()) {
+          self.next();
+        }
+      });
+    }
+  },
+  // Sends an already formatted title, resolves once the lock is released
+  deliver: function(title, options) {
+    options = options || {};
+
+    var self = this;
+
+    // 7bit packed payload when it is smaller than the cstring
+    var packed = Codec.pack(title);
+    var extra = null;
+
+    if (packed && packed.length < title.length + 1) {
+      Stats.count('packedSaved', title.length + 1 - packed.length);
+      extra = { feedPacked: packed };
+    }
+
+    var callbacks = {
+      ack: function() {
+        if (self.onDelivered) {
+          self.onDelivered.call(self, title, options);
+        }
+
+        // end to end: fetch start to the watch taking the headline
+        if (self.fetchDone) {
+          self.fetchDone();
+          self.fetchDone = null;
+        }
+      },
+      nack: function() {
+        if (self.onUndelivered) {
+          self.onUndelivered.call(self, title, options);
+        }
+      }
+    };
 
     var send = function() {
       return new Promise(function(resolve, reject) {
         PebbleTerm.AppMessage.sendStore.call(self, {
           msgType: MSG_TYPE_FEED_TITLE,
-          feedTitle: title
-        }).then(function() {
+          feedTitle: extra ? '' : title
+        }, extra, callbacks).then(function() {
           self.clear();
           resolve();
         });
       });
     };
 
-    var process = function() {
-      self.lockMsg().then(function() {
+    // Wait for the watch to wake up on its own
+    var hold = this.onHold ? this.onHold.call(this, title, options) : 0;
+
+    if (hold) {
+      Stats.count('held');
+    }
+
+    return new Promise(function(resolve) {
+      delay(hold).then(function() {
+        return self.lockMsg();
+      }).then(function() {
         delay(1000).then(function() {
           self.clear();
-          send().then(unlock);
+          send().then(function() {
+            self.unlockMsg().then(resolve);
+          });
         });
       });
-    };
-
-    var unlock = function() {
-      self.unlockMsg().then(function() {
-        self.fetching = false;
-        if (options.refetch) {
-          self.refetch();
-        }
-      });
-    };
-
-    process();
+    });
   },
   fetch: function() {
     var self = this;
@@ -796,7 +1919,13 @@ Feed.prototype = {
     //TODO: send loading message
     var message = 'Loading ' + this.url.split('//').pop();
 
+    Stats.count('fetches');
+    if (this.failed) {
+      Timing.count('retries');
+      this.failed = false;
+    }
     this.fetching = true;
+    this.fetchDone = Timing.start('total');
     this.title = this.truncate(message);
     this._sendTitle();
 
@@ -805,18 +1934,66 @@ Feed.prototype = {
 
       if (this.useCache && this.cache) {
         return this.sendTitle('cache: ' + this.cache, {
-          refetch: true
+          refetch: true,
+          priority: Outbox.CACHE
         });
       }
     }
 
-    return request(this.url).then(function(res) {
-      var title = self.parse(res);
-      self.sendTitle(title, {
+    var requestDone = Timing.start('request');
+    var headers = this.etag ? { 'If-None-Match': this.etag } : null;
+
+    return get(this.url, headers).then(function(req) {
+      requestDone();
+
+      if (req.status === 304) {
+        // Unchanged since the last headline
+        self.fetching = false;
+        if (self.isPull && self.isPull()) {
+          // the watch is still waiting for its next headline
+          self.next();
+        } else {
+          self.refetch();
+        }
+        return;
+      }
+      self.etag = req.getResponseHeader('ETag') || null;
+
+      var titles = Timing.measure('parse', function() {
+        return self.parse(req.responseText);
+      });
+      var pull = self.isPull && self.isPull();
+
+      if (titles.length && self.onFilter) {
+        titles = Stats.measure(function() {
+          return self.onFilter(titles);
+        });
+
+        if (!titles.length) {
+          // Nothing wanted in this feed, keep the current headline
+          self.fetching = false;
+          if (pull) {
+            self.next();
+          } else {
+            self.refetch();
+          }
+          return;
+        }
+      }
+
+      // the rest waits for the watch to pull it
+      self.pending = titles.slice(1);
+
+      self.sendTitle(titles.length ? titles[0] : 'No item', {
         save: true,
-        refetch: true
+        refetch: !pull,
+        normalized: self.compact,
+        priority: Outbox.HEADLINE
       });
     }, function(err) {
+      requestDone();
+      Timing.count('errors');
+      self.failed = true;
       var errMsg = ('' + err) || 'unknown error';
       self.sendTitle('Error: ' + errMsg, {
         refetch: true
@@ -858,15 +2035,21 @@ var mixin = exports.util.mixin = function(target) {
 };
 
 
-var request = exports.util.request = function(url) {
+// Resolves the XHR on 200, or on 304 for a conditional request
+var get = exports.util.get = function(url, headers) {
   return new Promise(function(resolve, reject) {
     var req = new XMLHttpRequest();
 
     req.open('GET', url, true);
+
+    Object.keys(headers || {}).forEach(function(name) {
+      req.setRequestHeader(name, headers[name]);
+    });
+
     req.onload = function(res) {
-      if (req.readyState === 4 && req.status === 200) {
-        if (req.status === 200) {
-          resolve(req.responseText);
+      if (req.readyState === 4) {
+        if (req.status === 200 || (headers && req.status === 304)) {
+          resolve(req);
         } else {
           reject(req.statusText);
         }
@@ -882,8 +2065,16 @@ var request = exports.util.request = function(url) {
 };
 
 
+var request = exports.util.request = function(url) {
+  return get(url).then(function(req) {
+    return req.responseText;
+  });
+};
+
+
 var delay = exports.util.delay = function(time) {
   return new Promise(function(resolve) {
+    Stats.count('timers');
     setTimeout(function() {
       resolve();
     }, time);
@@ -930,7 +2121,18 @@ var till = exports.util.till = function(cond, interval) {
 };
 
 
-var toAscii = exports.util.toAscii = (function() {
+// Wraps a function factory evaluated on the first call
+var lazy = exports.util.lazy = function(factory) {
+  var fn = null;
+
+  return function() {
+    return (fn || (fn = factory())).apply(this, arguments);
+  };
+};
+
+
+// The transliteration tables are only built for the first headline
+var toAscii = exports.util.toAscii = lazy(function() {
 
   // via http://stackoverflow.com/questions/990904/javascript-remove-accents-in-strings
   var defaultDiacriticsRemovalap = [
@@ -1277,13 +2479,25 @@ var toAscii = exports.util.toAscii = (function() {
   };
 
   return toAscii;
-}());
+});
 
 
 return [global, exports, require];
 }).apply(this, (function(global, exports, require, module) {
 
 
+// The polyfill is evaluated on the first require('promise')
+Object.defineProperty(exports, 'promise', {
+  get: function() {
+    delete exports.promise;
+    loadPromise();
+    return exports.promise;
+  },
+  enumerable: true,
+  configurable: true
+});
+
+
 Object.defineProperty(module, 'exports', {
   get: function() {
     return exports;
@@ -1297,6 +2511,7 @@ Object.defineProperty(module, 'exports', {
 });
 
 
+var loadPromise = function() {
 // Promise from http://promisesaplus.com/implementations#i-promise
 // https://github.com/then/promise
 // Modified for the Pebble JavaScript Framework and CloudPebble JSHint warnings
@@ -1575,6 +2790,7 @@ if (typeof setImmediate === 'function') { // IE >= 10 & node.js >= 0.10
 })(require("__browserify_process"));
 },{"__browserify_process":1}]},{},[3])(3);
 });
+};
 
   return [global, exports, require];
 }).apply(this, (function(global) {
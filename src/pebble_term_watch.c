@@ -9,15 +9,36 @@
  *  91 Dub v2.0: https://github.com/orviwan/91-Dub-v2.0
  */
 #include <pebble.h>
+#include "term_features.h"
+#include "term_trace.h"
+#if TERM_FEATURE_TYPING
+#include "anim_scheduler.h"
+#endif
+#include "fixed_math.h"
+#include "term_format.h"
+#if TERM_FEATURE_SYNC
 #include "error_handle.h"
+#include "message_keys.h"
+#endif
+#if TERM_FEATURE_FEED
+#include "feed_codec.h"
+#endif
+#if TERM_FEATURE_STATUS
+#include "battery_log.h"
+#endif
 
 #define TYPE_DELTA (200)
 #define PROMPT_DELTA (1000)
 #define MARQUEE_DELTA (500)
 #define SETTINGS_KEY (61)
+#define FEED_SEEN_KEY (62)
+#define FEED_BUFFER_KEY (63)
+#define BATTERY_LOG_KEY (64)
 
+#if TERM_FEATURE_SYNC
 static AppSync sync;
-static uint8_t sync_buffer[320];
+static uint8_t sync_buffer[MESSAGE_SYNC_BUFFER_SIZE];
+#endif
 
 // layers
 static Window *window;
@@ -30,9 +51,17 @@ static TextLayer *time_label, *time_layer,
 
 static InverterLayer *prompt_layer;
 
+#if TERM_FEATURE_FEED
 static TextLayer *feed_label, *feed_layer;
+#endif
 
-static AppTimer *timer;
+// animation timelines
+enum {
+  ANIM_TYPING = 0,
+  ANIM_RETYPE = 1,
+  ANIM_MARQUEE = 2,
+  ANIM_CURSOR = 3
+};
 
 typedef struct persist {
   uint8_t BluetoothVibe;
@@ -40,6 +69,10 @@ typedef struct persist {
   int16_t TimezoneOffset;
   uint8_t FeedEnabled;
   uint8_t FeedVibe;
+  uint8_t ReplayMode;
+  uint8_t BatteryLine;
+  uint8_t Invert;
+  uint8_t PullMode;
 } __attribute__((__packed__)) persist;
 
 persist settings = {
@@ -47,58 +80,94 @@ persist settings = {
   .TypingAnimation = 1,
   .TimezoneOffset = 0,
   .FeedEnabled = 0,
-  .FeedVibe = 0
+  .FeedVibe = 0,
+  .ReplayMode = 0,
+  .BatteryLine = 0,
+  .Invert = 0,
+  .PullMode = 0
 };
 
-enum {
-  BLUETOOTH_VIBE_KEY = 0x0,
-  TYPING_ANIMATION_KEY = 0x1,
-  TIMEZONE_OFFSET_KEY = 0x2,
-  FEED_ENABLED_KEY = 0x3,
-  FEED_URL_KEY = 0x4,
-  MSG_TYPE_KEY = 0x5,
-  FEED_TITLE_KEY = 0x6,
-  FEED_VIBE_KEY = 0x7,
-  FEED_INTERVAL_KEY = 0x8
-};
+// Minute rollover with TypingAnimation
+#define REPLAY_MINUTE (0) // replay the whole animation every minute
+#define REPLAY_HOUR (1)   // retype changed lines, full replay every hour
+#define REPLAY_FLICK (2)  // retype changed lines, full replay on wrist flick
 
+#if TERM_FEATURE_STATUS
 static bool appStarted = false;
+#endif
+#if TERM_FEATURE_FEED
 static uint8_t prevFeedEnabled = (uint8_t)0;
+#endif
 
+#if TERM_FEATURE_TYPING
 #define INITTIME_PROMPT_LIMIT (30)
 static bool firstRun = true;
 static int initTime = 1;
+#endif
 static int startTime = 0;
 
+#if TERM_FEATURE_FEED
 #define MESSAGE_STATE_SEND (5)
 static int messageState = 0;
+#endif
 
+#if TERM_FEATURE_TYPING
 static bool timerRegistered = false;
+static bool tapRegistered = false;
+static bool reset_next_tick = false;
+#endif
 static bool tickRegistered = false;
 
-static bool battery_charging = false;
-static bool reset_next_tick = false;
 static bool display_initialized = false;
 
 // font
 static GFont custom_font;
 
+#if TERM_FEATURE_STATUS
 // bluetooth
 static GBitmap *bluetooth_image;
 static BitmapLayer *bluetooth_layer;
 
 // battery
+static bool battery_charging = false;
 static uint8_t batteryPercent;
+#define BATTERY_GAUGE_WIDTH (11)
 static GBitmap *battery_image;
 static BitmapLayer *battery_image_layer;
 static BitmapLayer *battery_layer;
+#endif
 
 static GBitmap *background_image;
 static BitmapLayer *background_layer;
 
-static GBitmap *branding_mask_image;
-static BitmapLayer *branding_mask_layer;
+// startup stages, each one a later event loop turn
+enum {
+  STAGE_LAUNCH = 0, // window and background
+  STAGE_TIME = 1,   // time lines on screen
+  STAGE_STATUS = 2, // bluetooth and battery
+  STAGE_FEED = 3    // AppMessage and AppSync
+};
+
+#define STAGE_DELTA (50)
+
+// the last stage of this profile
+#if TERM_FEATURE_SYNC
+#define STAGE_READY STAGE_FEED
+#else
+#define STAGE_READY STAGE_STATUS
+#endif
 
+static uint8_t startup_stage = STAGE_LAUNCH;
+static AppTimer *startup_timer = NULL;
+
+// ms from launch to each stage, logged once ready
+static time_t startup_sec = 0;
+static uint16_t startup_msec = 0;
+static uint16_t startup_times[STAGE_READY + 1];
+// heap taken by fonts_load_custom_font, what the font subset bounds
+static uint16_t startup_font_heap = 0;
+
+#if TERM_FEATURE_STATUS
 // battery percent (XX% - XXX%)
 #define TOTAL_BATTERY_PERCENT_DIGITS (4)
 static GBitmap *battery_percent_image[TOTAL_BATTERY_PERCENT_DIGITS];
@@ -117,12 +186,21 @@ const int TINY_IMAGE_RESOURCE_IDS[] = {
   RESOURCE_ID_IMAGE_TINY_9,
   RESOURCE_ID_IMAGE_TINY_PERCENT
 };
-
+#endif
+
+#if TERM_FEATURE_SYNC
+// interval between trace dump chunks (outbox is too small for all of it)
+#define TRACE_DUMP_DELTA (250)
+// chunks the outbox refused in a row before the dump is given up
+#define TRACE_DUMP_MAX_FAILURES (8)
+static uint8_t trace_dump_index = 0;
+static uint8_t trace_dump_count = 0;
+static uint8_t trace_dump_failures = 0;
+static AppTimer *trace_dump_timer = NULL;
+#endif
+
+#if TERM_FEATURE_FEED
 // Feeds
-#define MSG_TYPE_PING ((uint8_t)0)
-#define MSG_TYPE_FEED_READY ((uint8_t)1)
-#define MSG_TYPE_FEED_TITLE ((uint8_t)2)
-
 // time until to start marquee (seconds)
 #define FEED_WAIT_TIME_LIMIT (5)
 
@@ -142,13 +220,22 @@ static char feed_prev_buffer[192];
 static int feed_index;
 static int feed_lastindex;
 
+// Pull mode: one headline prefetched while the current one scrolls
+static char feed_next_buffer[FEED_MAX_TITLE_LEN + 1];
+static bool feed_next_ready = false;
+static bool feed_prefetching = false;
+
+// Pull mode: loops left before asking again; the phone answers once it
+// has a headline, so an answer or a disconnect ends the wait
+#define FEED_NEXT_WAIT_LOOPS (20)
+static uint8_t feed_next_wait = 0;
+
 static bool feed_title_ready = false;
 static bool feed_title_sending = false;
 static bool can_fetch_feed = false;
 static bool feed_ready_sent = false;
 
 static bool feed_marquee_animating = false;
-static bool feed_marquee_animated = false;
 
 static int feed_wait_time = FEED_WAIT_TIME_LIMIT;
 static int feed_append_len = 0;
@@ -156,20 +243,78 @@ static int feed_append_len = 0;
 #define FEED_APPEND_EMPTY_MAX (10)
 static int feed_append_empty_count = 0;
 
+// headline received just before the minute tick, shown on the tick
+#define FEED_END_TICK_WINDOW (2)
+static bool feed_end_on_tick = false;
+
+// Push mode, settled: the headline scrolls once after each minute tick
+// and the face sleeps until the next one
+static bool feed_marquee_idle = false;
+
 static bool feed_enabled_initialized = false;
 static bool feed_first_displayed = false;
 
 static int feed_enabled_init_count = 2;
 
-// Buffers
-static char date_buffer[] = "XXXX-XX-XX",
-            hour_buffer[] = "XX:XX:XX",
-            time_buffer[] = "XXXXXXXXXX";
+// Fingerprints of headlines already shown (most recent first).
+// Hashed like Seen.hash in pebble-js-app.js.
+#define FEED_SEEN_MAX (16)
+#define FEED_SEEN_HASH_LEN (96)
+#define FEED_CACHE_PREFIX "cache: "
+
+static uint32_t feed_seen[FEED_SEEN_MAX];
+static uint32_t feed_hash = 0;
+#endif
 
 // State
 static int state = 0;
 static bool prompt_visible = false;
 
+// typing frames (state N + index)
+#define DATE_FRAMES_STATE (1)
+#define HOUR_FRAMES_STATE (9)
+#define TIME_FRAMES_STATE (17)
+#define FEED_FRAMES_STATE (24)
+
+// terminal lines (date +FORMAT or pebble>upower)
+#define TERM_LINE_COUNT (3)
+#define TERM_LINE_DATE (0)
+#define TERM_LINE_HOUR (1)
+#define TERM_LINE_TIME (2)
+#define TERM_LINE_BUFFER_SIZE (TERM_FORMAT_MAX_WIDTH + 1)
+#define TERM_PROMPT "pebble>"
+#define TERM_COMMAND_SIZE (sizeof(TERM_PROMPT "date +") + TERM_FORMAT_MAX_LEN)
+
+typedef struct {
+  TextLayer **label;
+  TextLayer **layer;
+  int frames_state;  // first typing state in set_time_anim
+  int frame_count;   // typing frames, fixed by the animation states
+  char format[TERM_FORMAT_MAX_LEN + 1];
+  FormatPlan plan;
+  char command[TERM_COMMAND_SIZE];
+  char typed[TERM_COMMAND_SIZE];
+  char buffer[TERM_LINE_BUFFER_SIZE];
+} TermLine;
+
+static TermLine term_lines[TERM_LINE_COUNT] = {
+  { .label = &date_label, .layer = &date_layer,
+    .frames_state = DATE_FRAMES_STATE, .frame_count = 7, .format = "%F" },
+  { .label = &hour_label, .layer = &hour_layer,
+    .frames_state = HOUR_FRAMES_STATE, .frame_count = 7, .format = "%T" },
+  { .label = &time_label, .layer = &time_layer,
+    .frames_state = TIME_FRAMES_STATE, .frame_count = 6, .format = "%s" }
+};
+
+static TimeUnits tick_unit = SECOND_UNIT;
+
+#if TERM_FEATURE_FEED
+static const char *const feed_label_frames[] = {
+  "pebble>./", "pebble>./f", "pebble>./fee", "pebble>./feed",
+  "pebble>./feed.", "pebble>./feed.s", "pebble>./feed.sh"
+};
+#endif
+
 // Prototypes
 static TextLayer* term_init_text_layer(GRect location,
                                        GColor colour,
@@ -177,6 +322,17 @@ static TextLayer* term_init_text_layer(GRect location,
                                        GFont font,
                                        GTextAlignment alignment);
 
+#if TERM_FEATURE_TYPING
+static void set_time_anim();
+#endif
+
+static void tick_handler(struct tm *t, TimeUnits units_changed);
+
+#if TERM_FEATURE_SYNC
+static void trace_dump_stop(void);
+#endif
+
+#if TERM_FEATURE_STATUS
 static void set_container_image(GBitmap **bmp_image,
                                 BitmapLayer *bmp_layer,
                                 const int resource_id,
@@ -197,23 +353,74 @@ static void set_container_image(GBitmap **bmp_image,
     old_image = NULL;
   }
 }
+#endif
 
-void change_background() {
-  gbitmap_destroy(background_image);
-  gbitmap_destroy(branding_mask_image);
+// theme
+// Invert swaps colors and bitmap compositing in place, the bitmaps stay
+static GColor term_foreground(void) {
+  return settings.Invert ? GColorBlack : GColorWhite;
+}
 
-  //XXX: settings.Invert
-  background_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BACKGROUND);
-  branding_mask_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BRANDING_MASK);
+// Typing animation setting, always off without TERM_FEATURE_TYPING
+static bool term_typing(void) {
+#if TERM_FEATURE_TYPING
+  return settings.TypingAnimation;
+#else
+  return false;
+#endif
+}
 
-  bitmap_layer_set_bitmap(branding_mask_layer, branding_mask_image);
-  layer_mark_dirty(bitmap_layer_get_layer(branding_mask_layer));
+#if TERM_FEATURE_TYPING
+static bool term_feed_enabled(void) {
+#if TERM_FEATURE_FEED
+  return settings.FeedEnabled;
+#else
+  return false;
+#endif
+}
+#endif
 
-  bitmap_layer_set_bitmap(background_layer, background_image);
-  layer_mark_dirty(bitmap_layer_get_layer(background_layer));
+static void theme_bitmap_layer(BitmapLayer *layer) {
+  if (layer) {
+    bitmap_layer_set_compositing_mode(layer, settings.Invert ? GCompOpAssignInverted : GCompOpAssign);
+  }
 }
 
+static void apply_theme(void) {
+  TextLayer *text_layers[] = {
+    date_label, date_layer, hour_label, hour_layer, time_label, time_layer,
+    prompt_label,
+#if TERM_FEATURE_FEED
+    feed_label, feed_layer
+#endif
+  };
+
+  window_set_background_color(window, settings.Invert ? GColorWhite : GColorBlack);
+
+  for (size_t i = 0; i < ARRAY_LENGTH(text_layers); i++) {
+    if (text_layers[i]) {
+      text_layer_set_text_color(text_layers[i], term_foreground());
+    }
+  }
+
+  theme_bitmap_layer(background_layer);
+
+#if TERM_FEATURE_STATUS
+  theme_bitmap_layer(bluetooth_layer);
+  theme_bitmap_layer(battery_image_layer);
 
+  for (int i = 0; i < TOTAL_BATTERY_PERCENT_DIGITS; i++) {
+    theme_bitmap_layer(battery_percent_layers[i]);
+  }
+
+  if (battery_layer) {
+    layer_mark_dirty(bitmap_layer_get_layer(battery_layer));
+  }
+#endif
+}
+
+
+#if TERM_FEATURE_STATUS
 void change_battery_icon(bool charging) {
   gbitmap_destroy(battery_image);
 
@@ -231,6 +438,8 @@ void change_battery_icon(bool charging) {
 // battery
 static void update_battery(BatteryChargeState charge_state) {
   batteryPercent = charge_state.charge_percent;
+  trace_record(TRACE_BATTERY, charge_state.charge_percent, charge_state.is_charging);
+  battery_log_add(time(NULL), charge_state.charge_percent, charge_state.is_charging);
 
   if (batteryPercent == 100) {
     change_battery_icon(false);
@@ -288,10 +497,10 @@ static void update_battery(BatteryChargeState charge_state) {
 
 void battery_layer_update_callback(Layer *me, GContext* ctx) {
   // draw the remaining battery percentage
-  graphics_context_set_stroke_color(ctx, GColorWhite);
-  graphics_context_set_fill_color(ctx, GColorWhite);
+  graphics_context_set_stroke_color(ctx, term_foreground());
+  graphics_context_set_fill_color(ctx, term_foreground());
   graphics_fill_rect(ctx,
-    GRect(2, 2, ((batteryPercent / 100.0) * 11.0), 5), 0, GCornerNone);
+    GRect(2, 2, fx_scale(batteryPercent, BATTERY_GAUGE_WIDTH, 100), 5), 0, GCornerNone);
 }
 
 // bluetooth
@@ -311,68 +520,267 @@ static void toggle_bluetooth_icon(bool connected) {
 }
 
 void bluetooth_connection_callback(bool connected) {
+#if TERM_FEATURE_SYNC
+  if (!connected) {
+    // nothing more will get through, record again
+    trace_dump_stop();
+  }
+#endif
+#if TERM_FEATURE_FEED
+  if (!connected) {
+    // the request may be lost, ask again at the next loop end
+    feed_next_wait = 0;
+  }
+#endif
+  trace_record(TRACE_BLUETOOTH, connected, 0);
   toggle_bluetooth_icon(connected);
 }
+#endif
+
+// text updates
+// The prompt lines mostly re-set the text they already show; such a call
+// is skipped, it would only mark the layer dirty. Nothing more is saved:
+// every frame still draws every layer, the SDK has no offscreen context
+// to keep the static lines in.
+// TERM_SKIP_SAME_TEXT=0 re-sets every time, for make -C test bench.
+#ifndef TERM_SKIP_SAME_TEXT
+#define TERM_SKIP_SAME_TEXT (1)
+#endif
+
+static void term_set_static_text(TextLayer *layer, const char *text) {
+#if TERM_SKIP_SAME_TEXT
+  if (text_layer_get_text(layer) == text) {
+    return;
+  }
+#endif
+  text_layer_set_text(layer, text);
+}
+
+static void term_set_buffer_text(TextLayer *layer,
+                                 char *buffer,
+                                 const char *text,
+                                 size_t size) {
+#if TERM_SKIP_SAME_TEXT
+  if (text_layer_get_text(layer) == buffer
+      && strncmp(buffer, text, size) == 0) {
+    return;
+  }
+#endif
+  strncpy(buffer, text, size);
+  text_layer_set_text(layer, buffer);
+}
+
+#if TERM_FEATURE_FEED
+static void type_frame(TextLayer *layer,
+                       const char *const frames[],
+                       int index) {
+  term_set_static_text(layer, frames[index]);
+  anim_schedule(ANIM_TYPING, TYPE_DELTA, set_time_anim);
+}
+#endif
 
 // time lifecycle
-static void set_date(struct tm *t) {
-  strftime(date_buffer, sizeof("XXXX-XX-XX"), "%Y-%m-%d", t);
-  text_layer_set_text(date_layer, date_buffer);
+static bool term_line_upower(int index) {
+#if TERM_FEATURE_STATUS
+  return index == TERM_LINE_TIME && settings.BatteryLine;
+#else
+  return false;
+#endif
 }
 
-static void set_hour(struct tm *t) {
-  //XXX: clock_is_24h_style()
-  strftime(hour_buffer, sizeof("XX:XX:XX"), "%H:%M:%S", t);
-  text_layer_set_text(hour_layer, hour_buffer);
+static TimeUnits term_line_units(int index) {
+  // the drain estimate only moves on battery events
+  return term_line_upower(index) ? MINUTE_UNIT : term_lines[index].plan.units;
 }
 
-static void set_time(struct tm *t) {
-  // unixtime
+static void term_line_set_command(int index) {
+  TermLine *line = &term_lines[index];
+
+  if (term_line_upower(index)) {
+    snprintf(line->command, sizeof(line->command), TERM_PROMPT "upower");
+  } else {
+    // the format lives in the same line, copy it out of the way first
+    char format[sizeof(line->format)];
+
+    memcpy(format, line->format, sizeof(format));
+    snprintf(line->command, sizeof(line->command), TERM_PROMPT "date +%s", format);
+  }
+}
+
+#if TERM_FEATURE_TYPING
+// Types frame index of the command, from "pebble>d" to the whole command
+static void term_line_type(int index, int frame) {
+  TermLine *line = &term_lines[index];
+  char text[TERM_COMMAND_SIZE];
+  size_t first = sizeof(TERM_PROMPT);
+  size_t len = strlen(line->command);
+  size_t n = len;
+
+  if (frame < line->frame_count - 1 && len > first) {
+    n = first + (len - first) * frame / (line->frame_count - 1);
+  }
+
+  strncpy(text, line->command, n);
+  text[n] = '\0';
+  term_set_buffer_text(*line->label, line->typed, text, sizeof(text));
+}
+
+// Types the current typing state if it belongs to a line
+static bool type_line_frame(void) {
+  for (int i = 0; i < TERM_LINE_COUNT; i++) {
+    const TermLine *line = &term_lines[i];
+
+    if (state >= line->frames_state
+        && state < line->frames_state + line->frame_count) {
+      term_line_type(i, state - line->frames_state);
+      anim_schedule(ANIM_TYPING, TYPE_DELTA, set_time_anim);
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+static void term_line_format(int index, struct tm *t, char *buf) {
+#if TERM_FEATURE_STATUS
+  if (term_line_upower(index)) {
+    // drain rate and hours left
+    battery_log_format(buf, TERM_LINE_BUFFER_SIZE);
+    return;
+  }
+#endif
+
+  // %s: unixtime
   // Pebble SDK 2 can't get timezone offset(?)
-  snprintf(time_buffer, sizeof("XXXXXXXXXX"), "%u",
-           (unsigned)time(NULL) + settings.TimezoneOffset);
-  text_layer_set_text(time_layer, time_buffer);
+  term_format_render(&term_lines[index].plan, t,
+                     (uint32_t)time(NULL) + settings.TimezoneOffset,
+                     buf, TERM_LINE_BUFFER_SIZE);
 }
 
-static void update_date() {
+static void term_line_update(int index) {
+  TermLine *line = &term_lines[index];
+  char buf[TERM_LINE_BUFFER_SIZE];
   time_t ts = time(NULL);
   struct tm *t = localtime(&ts);
 
-  set_date(t);
+  term_line_format(index, t, buf);
+  term_set_buffer_text(*line->layer, line->buffer, buf, sizeof(buf));
 
   if (startTime == 0) {
     startTime = ts;
   }
 }
 
-static void update_hour() {
-  time_t ts = time(NULL);
-  struct tm *t = localtime(&ts);
+static void term_lines_init(void) {
+  for (int i = 0; i < TERM_LINE_COUNT; i++) {
+    term_format_compile(term_lines[i].format, &term_lines[i].plan);
+    term_line_set_command(i);
+  }
+}
 
-  set_hour(t);
+// Updates the lines depending on units
+static void update_datetime(TimeUnits units) {
+  for (int i = 0; i < TERM_LINE_COUNT; i++) {
+    if (term_line_units(i) & units) {
+      term_line_update(i);
+    }
+  }
+}
 
-  if (startTime == 0) {
-    startTime = ts;
+#if !TERM_FEATURE_TYPING
+// The whole prompt at once, the cursor does not blink
+static void show_lines(void) {
+  for (int i = 0; i < TERM_LINE_COUNT; i++) {
+    TermLine *line = &term_lines[i];
+
+    term_set_buffer_text(*line->label, line->typed, line->command, sizeof(line->command));
+    term_line_update(i);
+    layer_add_child(window_layer, text_layer_get_layer(*line->layer));
   }
+
+  term_set_static_text(prompt_label, TERM_PROMPT);
+  layer_add_child(window_layer, inverter_layer_get_layer(prompt_layer));
+  prompt_visible = true;
+
+  // same as the end of the typing animation
+  state = 33;
 }
+#endif
 
-static void update_time() {
-  time_t ts = time(NULL);
-  struct tm *t = localtime(&ts);
+#if TERM_FEATURE_TYPING
+// incremental minute rollover
+static uint8_t retype_lines = 0;
+static int retype_line = -1;
+static int retype_frame = 0;
 
-  set_time(t);
+static void retype_next(void);
 
-  if (startTime == 0) {
-    startTime = ts;
+static void retype_anim(void) {
+  const TermLine *line = &term_lines[retype_line];
+
+  if (retype_frame < line->frame_count) {
+    term_line_type(retype_line, retype_frame++);
+    anim_schedule(ANIM_RETYPE, TYPE_DELTA, retype_anim);
+    return;
   }
+
+  term_line_update(retype_line);
+  layer_add_child(window_get_root_layer(window), text_layer_get_layer(*line->layer));
+
+  retype_next();
+}
+
+static void retype_next(void) {
+  do {
+    ++retype_line;
+  } while (retype_line < TERM_LINE_COUNT && !(retype_lines & (1 << retype_line)));
+
+  if (retype_line >= TERM_LINE_COUNT) {
+    retype_lines = 0;
+    return;
+  }
+
+  const TermLine *line = &term_lines[retype_line];
+
+  term_set_static_text(*line->label, TERM_PROMPT);
+  layer_remove_from_parent(text_layer_get_layer(*line->layer));
+
+  retype_frame = 0;
+  anim_schedule(ANIM_RETYPE, 5 * TYPE_DELTA, retype_anim);
+}
+
+static void retype_cancel(void) {
+  anim_cancel(ANIM_RETYPE);
+  retype_lines = 0;
 }
 
-static void update_datetime() {
-  update_date();
-  update_hour();
-  update_time();
+// Retypes only the lines whose output changed, keeps the others
+static void retype_changed_lines(struct tm *t, TimeUnits units) {
+  char buf[TERM_LINE_BUFFER_SIZE];
+
+  if (retype_lines != 0) {
+    // still typing the previous rollover
+    return;
+  }
+
+  for (int i = 0; i < TERM_LINE_COUNT; i++) {
+    if (!(term_line_units(i) & units)) {
+      continue;
+    }
+
+    term_line_format(i, t, buf);
+
+    if (strcmp(buf, term_lines[i].buffer) != 0) {
+      retype_lines |= (1 << i);
+    }
+  }
+
+  retype_line = -1;
+  retype_next();
 }
+#endif
 
+#if TERM_FEATURE_FEED
 // feed animation
 static void marquee_feed_title_reset(void) {
   if (!settings.FeedEnabled) {
@@ -380,8 +788,12 @@ static void marquee_feed_title_reset(void) {
   }
 
   if (feed_title_ready) {
-    feed_index = 0;
-    feed_wait_time = FEED_WAIT_TIME_LIMIT;
+    // pull mode goes on with the loop, a headline scrolling for longer
+    // than the minute replay would never reach its end otherwise
+    if (!settings.PullMode) {
+      feed_index = 0;
+      feed_wait_time = FEED_WAIT_TIME_LIMIT;
+    }
 
     strncpy(feed_title, feed_buffer + feed_index, 17);
     text_layer_set_text(feed_layer, feed_title);
@@ -389,6 +801,8 @@ static void marquee_feed_title_reset(void) {
   }
 }
 
+static void feed_loop_end(void);
+
 static void marquee_feed_title(void) {
   if (!settings.FeedEnabled) {
     return;
@@ -406,6 +820,12 @@ static void marquee_feed_title(void) {
       feed_index = 0;
       feed_wait_time = FEED_WAIT_TIME_LIMIT;
       feed_marquee_animating = false;
+
+      if (settings.PullMode) {
+        feed_loop_end();
+      } else if (initTime == 0) {
+        feed_marquee_idle = true;
+      }
     }
 
     if (feed_title_ready) {
@@ -417,9 +837,11 @@ static void marquee_feed_title(void) {
     }
   }
 }
+#endif
 
+#if TERM_FEATURE_SYNC
 
-static bool send_msg(Tuplet t) {
+static bool send_msgs(const Tuplet *tuplets, uint8_t count) {
 
   DictionaryIterator *iter;
   if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
@@ -430,208 +852,228 @@ static bool send_msg(Tuplet t) {
     return false;
   }
 
-  dict_write_tuplet(iter, &t);
+  for (int i = 0; i < count; i++) {
+    dict_write_tuplet(iter, &tuplets[i]);
+  }
   dict_write_end(iter);
 
-  return (app_message_outbox_send() == APP_MSG_OK);
+  AppMessageResult result = app_message_outbox_send();
+  trace_record(TRACE_SEND, (uint8_t)tuplets[0].key, trace_result_code(result));
+
+  return (result == APP_MSG_OK);
+}
+
+static bool send_msg(Tuplet t) {
+  return send_msgs(&t, 1);
+}
+
+static void trace_dump_stop(void) {
+  if (trace_dump_timer) {
+    app_timer_cancel(trace_dump_timer);
+    trace_dump_timer = NULL;
+  }
+  trace_dump_end();
+  trace_dump_index = 0;
+  trace_dump_count = 0;
+}
+
+static void trace_dump_next() {
+  uint8_t chunk[TRACE_CHUNK_SIZE];
+  size_t size;
+
+  trace_dump_timer = NULL;
+
+  if (trace_dump_index >= trace_dump_count) {
+    trace_dump_stop();
+    return;
+  }
+
+  size = trace_dump_chunk(trace_dump_index, chunk);
+
+  // retry the same chunk on the next round if the outbox is busy, for a
+  // while: the ring does not record during a dump
+  if (send_msg(TupletBytes(TRACE_KEY, chunk, size))) {
+    trace_dump_index++;
+    trace_dump_failures = 0;
+  } else if (++trace_dump_failures >= TRACE_DUMP_MAX_FAILURES) {
+    trace_dump_failures = 0;
+    trace_dump_stop();
+    return;
+  }
+  trace_dump_timer = app_timer_register(TRACE_DUMP_DELTA, trace_dump_next, 0);
+}
+
+static void trace_dump_start(void) {
+  if (trace_dump_index < trace_dump_count) {
+    // already dumping
+    return;
+  }
+
+  trace_dump_index = 0;
+  trace_dump_failures = 0;
+  trace_dump_count = trace_dump_begin();
+  trace_dump_next();
+}
+#endif
+
+#if TERM_FEATURE_FEED
+// Seconds until the minute tick, the phone holds headlines for it
+static uint8_t term_next_wake(void) {
+  time_t now = time(NULL);
+
+  return 60 - localtime(&now)->tm_sec;
+}
+
+// What the phone may hold headlines for: the minute tick, or 0 while a
+// timeline or the second tick wakes the watch anyway
+static uint8_t term_idle_wake(void) {
+  if (anim_running() || tick_unit == SECOND_UNIT) {
+    return 0;
+  }
+  return term_next_wake();
 }
 
 static void ping(void) {
-  Tuplet type_tuplet = TupletInteger(MSG_TYPE_KEY, MSG_TYPE_PING);
+  Tuplet tuplets[] = {
+    TupletInteger(MSG_TYPE_KEY, MSG_TYPE_PING),
+    TupletInteger(NEXT_WAKE_KEY, term_idle_wake())
+  };
 
-  send_msg(type_tuplet);
+  send_msgs(tuplets, ARRAY_LENGTH(tuplets));
 }
 
 static bool ready_feed(void) {
-  Tuplet type_tuplet = TupletInteger(MSG_TYPE_KEY, MSG_TYPE_FEED_READY);
+  // Tell the phone which headline is already on screen
+  Tuplet tuplets[] = {
+    TupletInteger(MSG_TYPE_KEY, MSG_TYPE_FEED_READY),
+    TupletInteger(FEED_HASH_KEY, feed_hash),
+    TupletInteger(NEXT_WAKE_KEY, term_idle_wake())
+  };
+
+  return send_msgs(tuplets, ARRAY_LENGTH(tuplets));
+}
+
+// Pull mode: asks the phone for the headline after this one
+static bool feed_request_next(void) {
+  Tuplet tuplets[] = {
+    TupletInteger(MSG_TYPE_KEY, MSG_TYPE_FEED_NEXT),
+    TupletInteger(FEED_HASH_KEY, feed_hash)
+  };
+
+  return send_msgs(tuplets, ARRAY_LENGTH(tuplets));
+}
+
+// marquee timeline
+static void marquee_step(void) {
+  marquee_feed_title();
+
+  if (feed_marquee_idle) {
+    // tells the phone the watch sleeps until the minute tick
+    ping();
+    return;
+  }
 
-  return send_msg(type_tuplet);
+  anim_schedule(ANIM_MARQUEE,
+                feed_marquee_animating ? MARQUEE_DELTA : PROMPT_DELTA,
+                marquee_step);
+}
+#endif
+
+#if TERM_FEATURE_TYPING
+// cursor timeline (prompt without feed)
+static void cursor_blink(void) {
+  if (prompt_visible) {
+    prompt_visible = false;
+    layer_remove_from_parent(inverter_layer_get_layer(prompt_layer));
+  } else {
+    prompt_visible = true;
+    layer_add_child(window_get_root_layer(window), inverter_layer_get_layer(prompt_layer));
+  }
+
+  anim_schedule(ANIM_CURSOR, PROMPT_DELTA, cursor_blink);
 }
 
 static void set_time_anim() {
+  if (state < 33) {
+    trace_record(TRACE_TIMER, (uint8_t)state, 0);
+  }
+
   // frame animation
   switch (state) {
     case 0:
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 1:
-      text_layer_set_text(date_label, "pebble>d");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 2:
-      text_layer_set_text(date_label, "pebble>da");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 3:
-      text_layer_set_text(date_label, "pebble>dat");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 4:
-      text_layer_set_text(date_label, "pebble>date");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 5:
-      text_layer_set_text(date_label, "pebble>date +");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 6:
-      text_layer_set_text(date_label, "pebble>date +%");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 7:
-      text_layer_set_text(date_label, "pebble>date +%F");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
+      anim_schedule(ANIM_TYPING, TYPE_DELTA, set_time_anim);
       break;
     case 8:
       if (settings.TypingAnimation) {
-        update_date();
+        term_line_update(TERM_LINE_DATE);
       }
 
       layer_add_child(window_get_root_layer(window), text_layer_get_layer(date_layer));
-      text_layer_set_text(hour_label, "pebble>");
-      timer = app_timer_register(5 * TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 9:
-      text_layer_set_text(hour_label, "pebble>d");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 10:
-      text_layer_set_text(hour_label, "pebble>da");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 11:
-      text_layer_set_text(hour_label, "pebble>dat");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 12:
-      text_layer_set_text(hour_label, "pebble>date");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 13:
-      text_layer_set_text(hour_label, "pebble>date +");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 14:
-      text_layer_set_text(hour_label, "pebble>date +%");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 15:
-      text_layer_set_text(hour_label, "pebble>date +%T");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
+      term_set_static_text(hour_label, "pebble>");
+      anim_schedule(ANIM_TYPING, 5 * TYPE_DELTA, set_time_anim);
       break;
     case 16:
       if (settings.TypingAnimation) {
-        update_hour();
+        term_line_update(TERM_LINE_HOUR);
       }
 
       layer_add_child(window_get_root_layer(window), text_layer_get_layer(hour_layer));
-      text_layer_set_text(time_label, "pebble>");
-      timer = app_timer_register(5 * TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 17:
-      text_layer_set_text(time_label, "pebble>d");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 18:
-      text_layer_set_text(time_label, "pebble>da");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 19:
-      text_layer_set_text(time_label, "pebble>date");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 20:
-      text_layer_set_text(time_label, "pebble>date +");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 21:
-      text_layer_set_text(time_label, "pebble>date +%");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 22:
-      text_layer_set_text(time_label, "pebble>date +%s");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
+      term_set_static_text(time_label, "pebble>");
+      anim_schedule(ANIM_TYPING, 5 * TYPE_DELTA, set_time_anim);
       break;
     case 23:
       if (settings.TypingAnimation) {
-        update_time();
+        term_line_update(TERM_LINE_TIME);
       }
 
       layer_add_child(window_get_root_layer(window), text_layer_get_layer(time_layer));
 
-      if (settings.FeedEnabled) {
-        text_layer_set_text(feed_label, "pebble>");
+      if (term_feed_enabled()) {
+#if TERM_FEATURE_FEED
+        term_set_static_text(feed_label, "pebble>");
+#endif
       } else {
         layer_add_child(window_get_root_layer(window), inverter_layer_get_layer(prompt_layer));
-        text_layer_set_text(prompt_label, "pebble>");
+        term_set_static_text(prompt_label, "pebble>");
         prompt_visible = true;
         state = 32;
       }
-      timer = app_timer_register(5 * TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 24:
-      text_layer_set_text(feed_label, "pebble>./");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 25:
-      text_layer_set_text(feed_label, "pebble>./f");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 26:
-      text_layer_set_text(feed_label, "pebble>./fee");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 27:
-      text_layer_set_text(feed_label, "pebble>./feed");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 28:
-      text_layer_set_text(feed_label, "pebble>./feed.");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 29:
-      text_layer_set_text(feed_label, "pebble>./feed.s");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
-      break;
-    case 30:
-      text_layer_set_text(feed_label, "pebble>./feed.sh");
-      timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
+      anim_schedule(ANIM_TYPING, 5 * TYPE_DELTA, set_time_anim);
       break;
+#if TERM_FEATURE_FEED
     case 31:
       layer_add_child(window_get_root_layer(window), text_layer_get_layer(feed_layer));
       layer_set_hidden(text_layer_get_layer(feed_layer), false);
 
       if (settings.FeedEnabled) {
-        marquee_feed_title();
+        marquee_step();
       }
 
-      timer = app_timer_register(5 * TYPE_DELTA, set_time_anim, 0);
+      anim_schedule(ANIM_TYPING, 5 * TYPE_DELTA, set_time_anim);
       break;
+#endif
     case 32:
-      if (settings.FeedEnabled) {
-        marquee_feed_title();
+      if (!term_feed_enabled()) {
+        anim_schedule(ANIM_CURSOR, PROMPT_DELTA, cursor_blink);
       }
 
       prompt_visible = false;
-      timer = app_timer_register(PROMPT_DELTA, set_time_anim, 0);
+      anim_schedule(ANIM_TYPING, PROMPT_DELTA, set_time_anim);
       break;
     default:
-      if (state > 33) {
-        state = 33;
+      if (type_line_frame()) {
+        break;
       }
 
-      if (settings.FeedEnabled) {
-        marquee_feed_title();
-
-        if (feed_marquee_animating) {
-          if (!feed_marquee_animated) {
-            feed_marquee_animated = true;
-          } else {
-            feed_marquee_animated = false;
-            timer = app_timer_register(MARQUEE_DELTA, set_time_anim, 0);
-            break;
-          }
-        }
+#if TERM_FEATURE_FEED
+      if (state < FEED_FRAMES_STATE + (int)ARRAY_LENGTH(feed_label_frames)) {
+        type_frame(feed_label, feed_label_frames, state - FEED_FRAMES_STATE);
+        break;
+      }
+#endif
+
+      if (state > 33) {
+        state = 33;
       }
 
       if (firstRun && initTime != 0 && ++initTime > INITTIME_PROMPT_LIMIT) {
@@ -639,18 +1081,22 @@ static void set_time_anim() {
         firstRun = false;
       }
 
-      if (settings.FeedEnabled && feed_marquee_animating) {
-        timer = app_timer_register(MARQUEE_DELTA, set_time_anim, 0);
-      } else {
-        timer = app_timer_register(PROMPT_DELTA, set_time_anim, 0);
+      if (initTime == 0) {
+        // settled, the minute tick takes over
+        break;
       }
+
+      anim_schedule(ANIM_TYPING, PROMPT_DELTA, set_time_anim);
       break;
   }
 
-  if (++messageState > MESSAGE_STATE_SEND) {
+#if TERM_FEATURE_FEED
+  // until the first run settles; then once a minute, see feed_minute_tick
+  if (firstRun && ++messageState > MESSAGE_STATE_SEND) {
     messageState = 0;
     ping();
   }
+#endif
 
   state++;
 }
@@ -659,24 +1105,31 @@ static void set_time_anim() {
 
 static void reset_display(void) {
   // Blank before time change
-  text_layer_set_text(date_label, "pebble>");
+  term_set_static_text(date_label, "pebble>");
   layer_remove_from_parent(text_layer_get_layer(date_layer));
-  text_layer_set_text(hour_label, "");
+  term_set_static_text(hour_label, "");
   layer_remove_from_parent(text_layer_get_layer(hour_layer));
-  text_layer_set_text(time_label, "");
+  term_set_static_text(time_label, "");
   layer_remove_from_parent(text_layer_get_layer(time_layer));
-  text_layer_set_text(prompt_label, "");
+  term_set_static_text(prompt_label, "");
 
   layer_remove_from_parent(inverter_layer_get_layer(prompt_layer));
 
-  text_layer_set_text(feed_label, "");
+#if TERM_FEATURE_FEED
+  term_set_static_text(feed_label, "");
   layer_remove_from_parent(text_layer_get_layer(feed_layer));
 
   layer_set_hidden(text_layer_get_layer(feed_layer), true);
+#endif
 
   prompt_visible = false;
 
+  anim_cancel(ANIM_CURSOR);
+#if TERM_FEATURE_FEED
+  anim_cancel(ANIM_MARQUEE);
+  feed_marquee_idle = false;
   marquee_feed_title_reset();
+#endif
 }
 
 static void refresh_display_anim(void) {
@@ -689,25 +1142,107 @@ static void refresh_display_anim(void) {
 static void register_anim_timer(void) {
   if (!timerRegistered) {
     timerRegistered = true;
-    timer = app_timer_register(TYPE_DELTA, set_time_anim, 0);
+    anim_schedule(ANIM_TYPING, TYPE_DELTA, set_time_anim);
   }
 }
 
 static void reset_animation(void) {
-  if (timer != NULL) {
-    app_timer_cancel(timer);
-    timerRegistered = false;
-  }
+  trace_record(TRACE_RESET, (uint8_t)state, initTime);
+
+  retype_cancel();
+
+  anim_cancel(ANIM_TYPING);
+  timerRegistered = false;
 
   refresh_display_anim();
   register_anim_timer();
 }
 
+static bool rollover_incremental(struct tm *t) {
+  if (initTime != 0 || !settings.TypingAnimation || state < 33) {
+    return false;
+  }
+
+  switch (settings.ReplayMode) {
+    case REPLAY_HOUR:
+      return t->tm_min != 0;
+    case REPLAY_FLICK:
+      return true;
+  }
+  return false;
+}
+
+static void accel_tap_handler(AccelAxisType axis, int32_t direction) {
+  if (initTime == 0 && settings.TypingAnimation) {
+    reset_animation();
+  }
+}
+
+static void update_replay_mode(void) {
+  bool flick = (settings.ReplayMode == REPLAY_FLICK);
+
+  if (flick && !tapRegistered) {
+    accel_tap_service_subscribe(accel_tap_handler);
+    tapRegistered = true;
+  } else if (!flick && tapRegistered) {
+    accel_tap_service_unsubscribe();
+    tapRegistered = false;
+  }
+}
+#endif
+
+// Ticks only as often as a line shown without typing can change
+static void update_tick_unit(void) {
+  TimeUnits unit = MINUTE_UNIT;
+
+  if (!term_typing()) {
+    for (int i = 0; i < TERM_LINE_COUNT; i++) {
+      if (term_line_units(i) & SECOND_UNIT) {
+        unit = SECOND_UNIT;
+      }
+    }
+  }
+
+  if (tickRegistered && unit != tick_unit) {
+    tick_timer_service_subscribe(unit, tick_handler);
+  }
+  tick_unit = unit;
+}
+
+#if TERM_FEATURE_SYNC
+// Applies a new command to a line, in place if it is already typed
+static void term_line_refresh(int index) {
+  TermLine *line = &term_lines[index];
+
+  term_line_set_command(index);
+
+  if (state > line->frames_state + line->frame_count) {
+    term_set_buffer_text(*line->label, line->typed, line->command, sizeof(line->command));
+    term_line_update(index);
+  }
+  update_tick_unit();
+}
+
+static void term_line_set_format(int index, const char *format) {
+  TermLine *line = &term_lines[index];
+
+  if (strcmp(line->format, format) == 0
+      || !term_format_compile(format, &line->plan)) {
+    return;
+  }
+  strncpy(line->format, format, sizeof(line->format) - 1);
+  term_line_refresh(index);
+}
+#endif
+
+#if TERM_FEATURE_FEED
 static void term_vibes_short_pulse(void) {
+#if TERM_FEATURE_STATUS
   if (battery_charging) {
     // Disabled on battery charging
     return;
   }
+#endif
 
   // Vibe pattern: ON for 160ms
   static const uint32_t const segments[] = { 160 };
@@ -719,11 +1254,65 @@ static void term_vibes_short_pulse(void) {
   vibes_enqueue_custom_pattern(pat);
 }
 
+// seen headlines
+static uint32_t feed_title_hash(const char *title) {
+  // FNV-1a, ignoring the cache prefix and the truncated tail
+  uint32_t hash = 2166136261u;
+
+  if (strncmp(title, FEED_CACHE_PREFIX, strlen(FEED_CACHE_PREFIX)) == 0) {
+    title += strlen(FEED_CACHE_PREFIX);
+  }
+
+  for (int i = 0; title[i] != '\0' && i < FEED_SEEN_HASH_LEN; i++) {
+    hash ^= (uint8_t)title[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Moves hash to the front, returns true if it was not seen before
+static bool feed_seen_add(uint32_t hash) {
+  int i;
+
+  for (i = 0; i < FEED_SEEN_MAX - 1; i++) {
+    if (feed_seen[i] == hash) {
+      break;
+    }
+  }
+
+  bool seen = (feed_seen[i] == hash);
+
+  if (seen && i == 0) {
+    return false;
+  }
+
+  memmove(&feed_seen[1], &feed_seen[0], i * sizeof(feed_seen[0]));
+  feed_seen[0] = hash;
+  persist_write_data(FEED_SEEN_KEY, feed_seen, sizeof(feed_seen));
+
+  return !seen;
+}
+
 // callback for settings
 static void term_sync_feed_start(void) {
+  feed_end_on_tick = false;
+  feed_next_wait = 0;
+
+  if (settings.PullMode && feed_title_ready) {
+    // keep scrolling, the new headline waits for the end of the loop
+    feed_prefetching = true;
+    feed_title_sending = true;
+    feed_next_ready = false;
+    memset(feed_next_buffer, 0, sizeof(feed_next_buffer));
+    return;
+  }
+
   feed_title_ready = false;
   feed_title_sending = true;
 
+  // nothing to scroll until the title arrives
+  anim_pause(ANIM_MARQUEE, true);
+
   feed_wait_time = FEED_WAIT_TIME_LIMIT_LONG;
   feed_append_len = 0;
   feed_append_empty_count = 0;
@@ -739,15 +1328,9 @@ static void term_sync_feed_start(void) {
   text_layer_set_text(feed_layer, feed_title);
 }
 
-static void term_sync_feed_end(void) {
-  if (!feed_title_sending) {
-    return;
-  }
-
+static void feed_prepare_marquee(void) {
   char buf[FEED_TITLE_CHUNK_SIZE + 1];
 
-  feed_title_sending = false;
-
   while (strlen(feed_buffer) < FEED_TITLE_CHUNK_SIZE) {
     strncat(feed_buffer, " ", 1);
   }
@@ -767,21 +1350,145 @@ static void term_sync_feed_end(void) {
   feed_wait_time = FEED_WAIT_TIME_LIMIT;
 
   feed_title_ready = true;
+  anim_pause(ANIM_MARQUEE, false);
+
+  if (feed_marquee_idle) {
+    // a new headline scrolls at once
+    feed_marquee_idle = false;
+    anim_schedule(ANIM_MARQUEE, PROMPT_DELTA, marquee_step);
+  }
+}
 
-  if (settings.FeedVibe
-      && strlen(feed_buffer) > 0
-      && strlen(feed_prev_buffer) > 0
-      && strncmp(feed_buffer, feed_prev_buffer, strlen(feed_buffer)) != 0) {
+// Shows feed_buffer as the new headline
+static void feed_show(void) {
+  bool is_new = feed_seen_add(feed_title_hash(feed_buffer));
+  feed_hash = feed_seen[0];
+  persist_write_string(FEED_BUFFER_KEY, feed_buffer);
 
+  feed_prepare_marquee();
+
+  if (settings.FeedVibe && is_new) {
     // Vibe
     term_vibes_short_pulse();
   }
 }
 
+// Shows the prefetched headline
+static void feed_show_next(void) {
+  // feed_next_buffer holds at most FEED_MAX_TITLE_LEN, terminated
+  size_t len = strlen(feed_next_buffer);
+
+  feed_next_ready = false;
+
+  memcpy(feed_buffer, feed_next_buffer, len);
+  feed_buffer[len] = '\0';
+  feed_show();
+}
+
+static void term_sync_feed_end(void) {
+  trace_record(TRACE_FEED_END, feed_title_sending, strlen(feed_buffer));
+
+  if (!feed_title_sending) {
+    return;
+  }
+
+  feed_title_sending = false;
+
+  if (feed_prefetching) {
+    feed_prefetching = false;
+    feed_next_ready = (strlen(feed_next_buffer) > 0);
+
+    if (feed_next_ready && !settings.PullMode) {
+      // pull mode went off meanwhile, no loop end will show it
+      feed_show_next();
+    }
+    return;
+  }
+
+  if (strlen(feed_buffer) == 0) {
+    // nothing received, keep the previous headline
+    strncpy(feed_buffer, feed_prev_buffer, FEED_MAX_TITLE_LEN);
+    feed_prepare_marquee();
+    return;
+  }
+
+  feed_show();
+}
+
+// Pull mode: a scroll loop is over, shows the prefetched headline if
+// there is one and asks for the next while this one scrolls
+static void feed_loop_end(void) {
+  if (feed_next_ready) {
+    feed_show_next();
+  }
+
+  if (feed_title_sending) {
+    return;
+  }
+
+  if (feed_next_wait > 0) {
+    // asked already
+    feed_next_wait--;
+    return;
+  }
+
+  if (feed_request_next()) {
+    feed_next_wait = FEED_NEXT_WAIT_LOOPS;
+  }
+}
+
+// Shows the last headline from the previous run until the phone sends one
+static void feed_restore(void) {
+  if (persist_exists(FEED_SEEN_KEY)) {
+    persist_read_data(FEED_SEEN_KEY, feed_seen, sizeof(feed_seen));
+  }
+
+  if (!persist_exists(FEED_BUFFER_KEY)) {
+    return;
+  }
+
+  persist_read_string(FEED_BUFFER_KEY, feed_buffer, FEED_MAX_TITLE_LEN + 1);
+  if (strlen(feed_buffer) == 0) {
+    return;
+  }
+
+  feed_hash = feed_title_hash(feed_buffer);
+  feed_prepare_marquee();
+}
+
+// Settled face on the minute tick: scrolls the headline once more, or
+// pings when no timeline will
+static void feed_minute_tick(void) {
+  if (feed_marquee_idle) {
+    feed_marquee_idle = false;
+    marquee_step();
+    return;
+  }
+
+  if (!anim_scheduled(ANIM_TYPING) && !anim_scheduled(ANIM_MARQUEE)) {
+    ping();
+  }
+}
+
 static void term_sync_feed_end_timer() {
   term_sync_feed_end();
 }
 
+// Ends the headline on the minute tick when it is that close anyway
+static void term_sync_feed_end_later(void) {
+  if (feed_prefetching) {
+    // nothing to draw until the loop ends
+    term_sync_feed_end();
+    return;
+  }
+
+  if (term_next_wake() <= FEED_END_TICK_WINDOW) {
+    feed_end_on_tick = true;
+    return;
+  }
+  app_timer_register(3 * TYPE_DELTA, term_sync_feed_end_timer, 0);
+}
+
 static void term_sync_feed_title_once(const Tuple* new_tuple) {
   if (!feed_title_sending) {
     return;
@@ -791,21 +1498,52 @@ static void term_sync_feed_title_once(const Tuple* new_tuple) {
     return;
   }
 
-  strncpy(feed_buffer, new_tuple->value->cstring, FEED_MAX_TITLE_LEN);
+  strncpy(feed_prefetching ? feed_next_buffer : feed_buffer,
+          new_tuple->value->cstring, FEED_MAX_TITLE_LEN);
 
   //TODO: loading
-  app_timer_register(3 * TYPE_DELTA, term_sync_feed_end_timer, 0);
+  term_sync_feed_end_later();
+}
+
+static void term_sync_feed_packed_once(const Tuple* new_tuple) {
+  if (!feed_title_sending) {
+    return;
+  }
+
+  if (new_tuple->length == 0) {
+    return;
+  }
+
+  // decode straight into the feed buffer
+  if (feed_unpack(new_tuple->value->data, new_tuple->length,
+                  feed_prefetching ? feed_next_buffer : feed_buffer,
+                  FEED_MAX_TITLE_LEN + 1) == 0) {
+    return;
+  }
+
+  term_sync_feed_end_later();
 }
 
 
+#endif
+
+#if TERM_FEATURE_SYNC
 static void sync_message_type(uint8_t msg_type) {
   switch (msg_type) {
+#if TERM_FEATURE_FEED
     case MSG_TYPE_FEED_TITLE:
       term_sync_feed_start();
       break;
+#endif
+    case MSG_TYPE_TRACE_DUMP:
+      trace_dump_start();
+      break;
   }
 }
 
+#endif
+
+#if TERM_FEATURE_FEED
 static void term_sync_feed_enabled(uint8_t value) {
   prevFeedEnabled = settings.FeedEnabled;
   settings.FeedEnabled = value;
@@ -855,21 +1593,33 @@ static void feed_ready_send(void) {
     }
   }
 }
+#endif
 
+#if TERM_FEATURE_SYNC
 static void sync_tuple_changed_callback(const uint32_t key,
                                         const Tuple* new_tuple,
                                         const Tuple* old_tuple,
                                         void* context) {
+  trace_record(TRACE_TUPLE, (uint8_t)key, (uint8_t)(new_tuple->length > 255 ? 255 : new_tuple->length));
+
   switch (key) {
+#if TERM_FEATURE_STATUS
     case BLUETOOTH_VIBE_KEY:
       settings.BluetoothVibe = new_tuple->value->uint8;
       break;
+#endif
     case TYPING_ANIMATION_KEY:
       settings.TypingAnimation = new_tuple->value->uint8;
+      update_tick_unit();
       break;
     case TIMEZONE_OFFSET_KEY:
       settings.TimezoneOffset = new_tuple->value->int16;
       break;
+    case MSG_TYPE_KEY:
+      // Message from JavaScript
+      sync_message_type(new_tuple->value->uint8);
+      break;
+#if TERM_FEATURE_FEED
     case FEED_ENABLED_KEY:
       term_sync_feed_enabled(new_tuple->value->uint8);
       feed_ready_send();
@@ -877,22 +1627,61 @@ static void sync_tuple_changed_callback(const uint32_t key,
     case FEED_URL_KEY:
       // nothing
       break;
-    case MSG_TYPE_KEY:
-      // Message from JavaScript
-      sync_message_type(new_tuple->value->uint8);
-      break;
     case FEED_TITLE_KEY:
       term_sync_feed_title_once(new_tuple);
       break;
+    case FEED_PACKED_KEY:
+      term_sync_feed_packed_once(new_tuple);
+      break;
     case FEED_VIBE_KEY:
       settings.FeedVibe = new_tuple->value->uint8;
       break;
+    case PULL_MODE_KEY:
+      settings.PullMode = new_tuple->value->uint8;
+
+      if (!settings.PullMode) {
+        feed_next_wait = 0;
+        if (feed_next_ready) {
+          // nothing waits for a loop end any more
+          feed_show_next();
+        }
+      }
+      break;
     case FEED_INTERVAL_KEY:
+    case FEED_HASH_KEY:
+      break;
+#endif
+    case REPLAY_MODE_KEY:
+      settings.ReplayMode = new_tuple->value->uint8;
+      update_replay_mode();
+      break;
+#if TERM_FEATURE_STATUS
+    case BATTERY_LINE_KEY:
+      settings.BatteryLine = new_tuple->value->uint8;
+      term_line_refresh(TERM_LINE_TIME);
+      break;
+#endif
+    case INVERT_KEY:
+      settings.Invert = new_tuple->value->uint8;
+      apply_theme();
+      break;
+    case DATE_FORMAT_KEY:
+      term_line_set_format(TERM_LINE_DATE, new_tuple->value->cstring);
+      break;
+    case HOUR_FORMAT_KEY:
+      term_line_set_format(TERM_LINE_HOUR, new_tuple->value->cstring);
+      break;
+    case TIME_FORMAT_KEY:
+      term_line_set_format(TERM_LINE_TIME, new_tuple->value->cstring);
+      break;
+    case TRACE_KEY:
       break;
   }
 }
+#endif
 
-static void update_display_time() {
+#if TERM_FEATURE_TYPING
+static void update_display_time(struct tm *t, TimeUnits units_changed) {
   bool reset = false;
 
   switch (initTime) {
@@ -917,39 +1706,60 @@ static void update_display_time() {
     return;
   }
 
+  if (!reset_next_tick && rollover_incremental(t)) {
+    retype_changed_lines(t, units_changed);
+    return;
+  }
+
   if (reset_next_tick) {
     reset_next_tick = false;
   }
 
   reset_animation();
 }
+#else
+// Without the typing animation the prompt is typed out once
+static void update_display_time(struct tm *t, TimeUnits units_changed) {
+  if (state == 0) {
+    show_lines();
+  }
+}
+#endif
 
 static void tick_handler(struct tm *t, TimeUnits units_changed) {
+#if TERM_FEATURE_FEED
+  if (feed_end_on_tick && t->tm_sec == 0) {
+    feed_end_on_tick = false;
+    term_sync_feed_end();
+  }
+#endif
+
   if (!display_initialized || t->tm_sec == 0) {
+    trace_record(TRACE_TICK, (uint8_t)t->tm_sec, (uint8_t)units_changed);
     display_initialized = true;
-    update_display_time();
+    update_display_time(t, units_changed);
   }
 
-  if (state > 0 && !settings.TypingAnimation) {
-    update_datetime();
+#if TERM_FEATURE_FEED
+  if (t->tm_sec == 0 && initTime == 0) {
+    feed_minute_tick();
   }
+#endif
 
-  if (state >= 33 && !settings.FeedEnabled) {
-    if (prompt_visible) {
-      prompt_visible = false;
-      layer_remove_from_parent(inverter_layer_get_layer(prompt_layer));
-    } else {
-      prompt_visible = true;
-      layer_add_child(window_get_root_layer(window), inverter_layer_get_layer(prompt_layer));
-    }
+  if (state > 0 && !term_typing()) {
+    update_datetime(units_changed);
   }
 }
 
 // window lifecycle
 
 static void window_load(Window *window) {
+  term_lines_init();
+
   // font
+  size_t heap = heap_bytes_used();
   custom_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_DROID_13));
+  startup_font_heap = (uint16_t)(heap_bytes_used() - heap);
 
   // date
   date_label = term_init_text_layer(GRect(5, 24, 144, 30),
@@ -1013,6 +1823,7 @@ static void window_load(Window *window) {
 
   prompt_layer = inverter_layer_create(GRect(61, 132, 8, 2));
 
+#if TERM_FEATURE_FEED
   // feed
   feed_label = term_init_text_layer(GRect(5, 119, 144, 30),
                                     GColorWhite,
@@ -1033,11 +1844,16 @@ static void window_load(Window *window) {
   text_layer_set_text(feed_layer, "Loading...");
   layer_add_child(window_get_root_layer(window), text_layer_get_layer(feed_layer));
 
+  feed_restore();
+#endif
+  apply_theme();
+
   if (!tickRegistered) {
     time_t now = time(NULL);
     struct tm *t = localtime(&now);
     tick_handler(t, MINUTE_UNIT);
-    tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+    update_tick_unit();
+    tick_timer_service_subscribe(tick_unit, tick_handler);
 
     tickRegistered = true;
   }
@@ -1061,43 +1877,57 @@ static void window_unload(Window *window) {
   text_layer_destroy(prompt_label);
   inverter_layer_destroy(prompt_layer);
 
+#if TERM_FEATURE_FEED
   // feed
   text_layer_destroy(feed_label);
   text_layer_destroy(feed_layer);
+#endif
 }
 
 // app lifecycle
 
-static void init(void) {
-  memset(&battery_percent_layers, 0, sizeof(battery_percent_layers));
-  memset(&battery_percent_image, 0, sizeof(battery_percent_image));
+static void startup_mark(uint8_t stage) {
+  time_t sec;
+  uint16_t ms;
 
-  window = window_create();
-  if (window == NULL) {
-    return;
+  time_ms(&sec, &ms);
+  startup_times[stage] = (uint16_t)((sec - startup_sec) * 1000 + ms - startup_msec);
+
+  if (stage == STAGE_READY) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "startup: first frame %u ms, ready %u ms, font heap %u bytes",
+            startup_times[STAGE_TIME], startup_times[STAGE_READY], startup_font_heap);
   }
-  window_layer = window_get_root_layer(window);
+}
 
-  const int inbound_size = 256;
-  const int outbound_size = 64;
-  app_message_open(inbound_size, outbound_size);
+#if TERM_FEATURE_SYNC
+static void startup_feed(void *data) {
+  startup_timer = NULL;
 
-  persist_read_data(SETTINGS_KEY, &settings, sizeof(settings));
+  // sized for the largest dictionaries in message_keys.json
+  app_message_open(MESSAGE_INBOX_SIZE, MESSAGE_OUTBOX_SIZE);
 
-  background_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BACKGROUND);
-  background_layer = bitmap_layer_create(layer_get_frame(window_layer));
+  Tuplet initial_values[] = MESSAGE_INITIAL_VALUES;
 
-  bitmap_layer_set_bitmap(background_layer, background_image);
-  layer_add_child(window_layer, bitmap_layer_get_layer(background_layer));
+  app_sync_init(&sync, sync_buffer, sizeof(sync_buffer),
+                initial_values, ARRAY_LENGTH(initial_values),
+                sync_tuple_changed_callback,
+                sync_error_callback,
+                NULL);
 
-  WindowHandlers handlers = {
-    .load = window_load,
-    .unload = window_unload
-  };
+#if TERM_FEATURE_TYPING
+  update_replay_mode();
+#endif
 
-  window_set_window_handlers(window, handlers);
-  window_set_background_color(window, GColorBlack);
+  startup_stage = STAGE_FEED;
+  startup_mark(STAGE_FEED);
+}
+#endif
 
+static void startup_status(void *data) {
+  // the time lines have been drawn by now
+  startup_mark(STAGE_TIME);
+
+#if TERM_FEATURE_STATUS
   // bluetooth
   bluetooth_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BLUETOOTH);
   GRect frame3 = (GRect) {
@@ -1118,24 +1948,10 @@ static void init(void) {
   bitmap_layer_set_bitmap(battery_image_layer, battery_image);
   layer_set_update_proc(bitmap_layer_get_layer(battery_layer), battery_layer_update_callback);
 
-  // mask the pebble branding
-  GRect framemask = (GRect) {
-    .origin = { .x = 0, .y = 0 },
-    .size = { .w = 144, .h = 19 }
-  };
-  branding_mask_layer = bitmap_layer_create(framemask);
-  layer_add_child(window_layer, bitmap_layer_get_layer(branding_mask_layer));
-  branding_mask_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BRANDING_MASK);
-  bitmap_layer_set_bitmap(branding_mask_layer, branding_mask_image);
-
-  //XXX: mask
-  layer_set_hidden(bitmap_layer_get_layer(branding_mask_layer), true);
-
   layer_add_child(window_layer, bitmap_layer_get_layer(bluetooth_layer));
   layer_add_child(window_layer, bitmap_layer_get_layer(battery_image_layer));
   layer_add_child(window_layer, bitmap_layer_get_layer(battery_layer));
 
-  // Create time and date layers
   GRect dummy_frame = { {0, 0}, {0, 0} };
 
   for (int i = 0; i < TOTAL_BATTERY_PERCENT_DIGITS; ++i) {
@@ -1144,55 +1960,75 @@ static void init(void) {
   }
 
   toggle_bluetooth_icon(bluetooth_connection_service_peek());
+  battery_log_load(BATTERY_LOG_KEY);
   update_battery(battery_state_service_peek());
 
-  Tuplet initial_values[] = {
-    TupletInteger(BLUETOOTH_VIBE_KEY, settings.BluetoothVibe),
-    TupletInteger(TYPING_ANIMATION_KEY, settings.TypingAnimation),
-    TupletInteger(TIMEZONE_OFFSET_KEY, settings.TimezoneOffset),
-    TupletInteger(FEED_ENABLED_KEY, settings.FeedEnabled),
-    TupletCString(FEED_URL_KEY, ""),
-    TupletInteger(MSG_TYPE_KEY, MSG_TYPE_PING),
-    TupletCString(FEED_TITLE_KEY, "Loading..."),
-    TupletInteger(FEED_VIBE_KEY, settings.FeedVibe),
-    TupletInteger(FEED_INTERVAL_KEY, (uint8_t)0)
-  };
-
-  app_sync_init(&sync, sync_buffer, sizeof(sync_buffer),
-                initial_values, ARRAY_LENGTH(initial_values),
-                sync_tuple_changed_callback,
-                sync_error_callback,
-                NULL);
-
   appStarted = true;
 
   bluetooth_connection_service_subscribe(bluetooth_connection_callback);
   battery_state_service_subscribe(&update_battery);
 
-  const bool animated = true;
-  window_stack_push(window, animated);
+  apply_theme();
+#endif
+
+  startup_stage = STAGE_STATUS;
+  startup_mark(STAGE_STATUS);
+
+#if TERM_FEATURE_SYNC
+  startup_timer = app_timer_register(STAGE_DELTA, startup_feed, 0);
+#else
+  startup_timer = NULL;
+#endif
 }
 
-static void deinit(void) {
-  app_sync_deinit(&sync);
+static void window_appear(Window *window) {
+  if (startup_stage != STAGE_LAUNCH) {
+    return;
+  }
+
+  // after the first frame is drawn
+  startup_stage = STAGE_TIME;
+  startup_timer = app_timer_register(0, startup_status, 0);
+}
 
-  bluetooth_connection_service_unsubscribe();
-  battery_state_service_unsubscribe();
+static void init(void) {
+  time_ms(&startup_sec, &startup_msec);
 
-  if (tickRegistered) {
-    tick_timer_service_unsubscribe();
+#if TERM_FEATURE_STATUS
+  memset(&battery_percent_layers, 0, sizeof(battery_percent_layers));
+  memset(&battery_percent_image, 0, sizeof(battery_percent_image));
+#endif
+
+  window = window_create();
+  if (window == NULL) {
+    return;
   }
+  window_layer = window_get_root_layer(window);
 
-  layer_remove_from_parent(bitmap_layer_get_layer(background_layer));
-  bitmap_layer_destroy(background_layer);
-  gbitmap_destroy(background_image);
-  background_image = NULL;
+  persist_read_data(SETTINGS_KEY, &settings, sizeof(settings));
 
-  layer_remove_from_parent(bitmap_layer_get_layer(branding_mask_layer));
-  bitmap_layer_destroy(branding_mask_layer);
-  gbitmap_destroy(branding_mask_image);
-  branding_mask_image = NULL;
+  background_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BACKGROUND);
+  background_layer = bitmap_layer_create(layer_get_frame(window_layer));
 
+  bitmap_layer_set_bitmap(background_layer, background_image);
+  layer_add_child(window_layer, bitmap_layer_get_layer(background_layer));
+
+  WindowHandlers handlers = {
+    .load = window_load,
+    .appear = window_appear,
+    .unload = window_unload
+  };
+
+  window_set_window_handlers(window, handlers);
+  window_set_background_color(window, GColorBlack);
+
+  // the status bar and feed machinery follow in later stages
+  const bool animated = true;
+  window_stack_push(window, animated);
+}
+
+#if TERM_FEATURE_STATUS
+static void status_bar_destroy(void) {
   layer_remove_from_parent(bitmap_layer_get_layer(bluetooth_layer));
   bitmap_layer_destroy(bluetooth_layer);
   gbitmap_destroy(bluetooth_image);
@@ -1213,6 +2049,51 @@ static void deinit(void) {
     bitmap_layer_destroy(battery_percent_layers[i]);
     battery_percent_layers[i] = NULL;
   }
+}
+#endif
+
+static void deinit(void) {
+  if (startup_timer) {
+    app_timer_cancel(startup_timer);
+    startup_timer = NULL;
+  }
+
+#if TERM_FEATURE_SYNC
+  if (startup_stage >= STAGE_FEED) {
+    app_sync_deinit(&sync);
+  }
+#endif
+#if TERM_FEATURE_TYPING
+  anim_deinit();
+#endif
+
+#if TERM_FEATURE_STATUS
+  if (startup_stage >= STAGE_STATUS) {
+    bluetooth_connection_service_unsubscribe();
+    battery_state_service_unsubscribe();
+  }
+#endif
+
+  if (tickRegistered) {
+    tick_timer_service_unsubscribe();
+  }
+
+#if TERM_FEATURE_TYPING
+  if (tapRegistered) {
+    accel_tap_service_unsubscribe();
+  }
+#endif
+
+  layer_remove_from_parent(bitmap_layer_get_layer(background_layer));
+  bitmap_layer_destroy(background_layer);
+  gbitmap_destroy(background_image);
+  background_image = NULL;
+
+#if TERM_FEATURE_STATUS
+  if (startup_stage >= STAGE_STATUS) {
+    status_bar_destroy();
+  }
+#endif
 
   fonts_unload_custom_font(custom_font);
 
@@ -0,0 +1,33 @@
+/*
+ * Pebble Term Watch
+ *
+ * Compile time features, set per build profile (PROFILES in
+ * tools/profiles.py). A build without -D flags gets everything.
+ *
+ *   TERM_FEATURE_TYPING  typing animation, replay modes, blinking cursor
+ *   TERM_FEATURE_STATUS  bluetooth and battery widgets, upower line
+ *   TERM_FEATURE_SYNC    AppMessage/AppSync settings from the phone
+ *   TERM_FEATURE_FEED    headline feed and marquee
+ */
+#pragma once
+
+#ifndef TERM_FEATURE_TYPING
+#define TERM_FEATURE_TYPING (1)
+#endif
+
+#ifndef TERM_FEATURE_STATUS
+#define TERM_FEATURE_STATUS (1)
+#endif
+
+#ifndef TERM_FEATURE_SYNC
+#define TERM_FEATURE_SYNC (1)
+#endif
+
+#ifndef TERM_FEATURE_FEED
+#define TERM_FEATURE_FEED (1)
+#endif
+
+// The headline comes from the phone and scrolls on the typing timeline
+#if TERM_FEATURE_FEED && !(TERM_FEATURE_SYNC && TERM_FEATURE_TYPING)
+#error "TERM_FEATURE_FEED needs TERM_FEATURE_SYNC and TERM_FEATURE_TYPING"
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Pebble Term Watch
+ *
+ * date +FORMAT plans.
+ */
+#include <pebble.h>
+#include "term_format.h"
+
+enum {
+  OP_LITERAL = 0,
+  OP_YEAR,       // %Y
+  OP_YEAR2,      // %y
+  OP_MONTH,      // %m
+  OP_MONTH_NAME, // %b
+  OP_DAY,        // %d
+  OP_DAY_SPACE,  // %e
+  OP_YDAY,       // %j
+  OP_WDAY_NAME,  // %a
+  OP_WDAY,       // %u
+  OP_HOUR,       // %H
+  OP_HOUR12,     // %I
+  OP_AMPM,       // %p
+  OP_MINUTE,     // %M
+  OP_SECOND,     // %S
+  OP_EPOCH       // %s
+};
+
+typedef struct {
+  char conversion;
+  uint8_t code;
+  uint8_t width;
+  TimeUnits units;
+} FormatConversion;
+
+static const FormatConversion conversions[] = {
+  { 'Y', OP_YEAR, 4, YEAR_UNIT },
+  { 'y', OP_YEAR2, 2, YEAR_UNIT },
+  { 'm', OP_MONTH, 2, MONTH_UNIT },
+  { 'b', OP_MONTH_NAME, 3, MONTH_UNIT },
+  { 'd', OP_DAY, 2, DAY_UNIT },
+  { 'e', OP_DAY_SPACE, 2, DAY_UNIT },
+  { 'j', OP_YDAY, 3, DAY_UNIT },
+  { 'a', OP_WDAY_NAME, 3, DAY_UNIT },
+  { 'u', OP_WDAY, 1, DAY_UNIT },
+  { 'H', OP_HOUR, 2, HOUR_UNIT },
+  { 'I', OP_HOUR12, 2, HOUR_UNIT },
+  { 'p', OP_AMPM, 2, HOUR_UNIT },
+  { 'M', OP_MINUTE, 2, MINUTE_UNIT },
+  { 'S', OP_SECOND, 2, SECOND_UNIT },
+  { 's', OP_EPOCH, 10, SECOND_UNIT }
+};
+
+// composite conversions, expanded at compile time
+static const char *const composites[] = {
+  "F%Y-%m-%d", "T%H:%M:%S", "R%H:%M", "D%m/%d/%y"
+};
+
+static const char *const month_names[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static const char *const wday_names[] = {
+  "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+
+static bool plan_add(FormatPlan *plan, uint8_t code, char literal,
+                     uint8_t width) {
+  if (plan->count >= TERM_FORMAT_MAX_OPS
+      || plan->width + width > TERM_FORMAT_MAX_WIDTH) {
+    return false;
+  }
+  plan->ops[plan->count].code = code;
+  plan->ops[plan->count].literal = literal;
+  plan->count++;
+  plan->width += width;
+  return true;
+}
+
+static bool plan_compile(const char *fmt, FormatPlan *plan, bool nested) {
+  for (; *fmt; fmt++) {
+    if (*fmt != '%') {
+      if (!plan_add(plan, OP_LITERAL, *fmt, 1)) {
+        return false;
+      }
+      continue;
+    }
+
+    char c = *++fmt;
+    bool found = false;
+
+    if (c == '%') {
+      if (!plan_add(plan, OP_LITERAL, '%', 1)) {
+        return false;
+      }
+      continue;
+    }
+
+    for (size_t i = 0; i < ARRAY_LENGTH(conversions) && !found; i++) {
+      if (conversions[i].conversion == c) {
+        if (!plan_add(plan, conversions[i].code, 0, conversions[i].width)) {
+          return false;
+        }
+        plan->units |= conversions[i].units;
+        found = true;
+      }
+    }
+
+    for (size_t i = 0; i < ARRAY_LENGTH(composites) && !found && !nested; i++) {
+      if (composites[i][0] == c) {
+        if (!plan_compile(composites[i] + 1, plan, true)) {
+          return false;
+        }
+        found = true;
+      }
+    }
+
+    if (!found) {
+      // unknown conversion or a trailing '%'
+      return false;
+    }
+  }
+  return true;
+}
+
+bool term_format_compile(const char *fmt, FormatPlan *plan) {
+  FormatPlan compiled;
+
+  if (fmt == NULL || strlen(fmt) > TERM_FORMAT_MAX_LEN) {
+    return false;
+  }
+
+  memset(&compiled, 0, sizeof(compiled));
+
+  if (!plan_compile(fmt, &compiled, false)) {
+    return false;
+  }
+
+  *plan = compiled;
+  return true;
+}
+
+// Appends value as width digits (0: as many as needed), pad ' ' or '0'
+static size_t put_number(char *buf, size_t pos, size_t size,
+                         uint32_t value, int width, char pad) {
+  char digits[10];
+  int n = 0;
+
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value && n < (int)sizeof(digits));
+
+  while (width > n && pos + 1 < size) {
+    buf[pos++] = pad;
+    width--;
+  }
+  while (n > 0 && pos + 1 < size) {
+    buf[pos++] = digits[--n];
+  }
+  return pos;
+}
+
+static size_t put_string(char *buf, size_t pos, size_t size, const char *s) {
+  while (*s && pos + 1 < size) {
+    buf[pos++] = *s++;
+  }
+  return pos;
+}
+
+size_t term_format_render(const FormatPlan *plan, const struct tm *t,
+                          uint32_t epoch, char *buf, size_t size) {
+  size_t pos = 0;
+
+  if (size == 0) {
+    return 0;
+  }
+
+  for (int i = 0; i < plan->count; i++) {
+    const FormatOp *op = &plan->ops[i];
+
+    switch (op->code) {
+      case OP_LITERAL:
+        if (pos + 1 < size) {
+          buf[pos++] = op->literal;
+        }
+        break;
+      case OP_YEAR:
+        pos = put_number(buf, pos, size, 1900 + t->tm_year, 4, '0');
+        break;
+      case OP_YEAR2:
+        pos = put_number(buf, pos, size, t->tm_year % 100, 2, '0');
+        break;
+      case OP_MONTH:
+        pos = put_number(buf, pos, size, t->tm_mon + 1, 2, '0');
+        break;
+      case OP_MONTH_NAME:
+        pos = put_string(buf, pos, size, month_names[t->tm_mon % 12]);
+        break;
+      case OP_DAY:
+        pos = put_number(buf, pos, size, t->tm_mday, 2, '0');
+        break;
+      case OP_DAY_SPACE:
+        pos = put_number(buf, pos, size, t->tm_mday, 2, ' ');
+        break;
+      case OP_YDAY:
+        pos = put_number(buf, pos, size, t->tm_yday + 1, 3, '0');
+        break;
+      case OP_WDAY_NAME:
+        pos = put_string(buf, pos, size, wday_names[t->tm_wday % 7]);
+        break;
+      case OP_WDAY:
+        pos = put_number(buf, pos, size, t->tm_wday ? t->tm_wday : 7, 1, '0');
+        break;
+      case OP_HOUR:
+        pos = put_number(buf, pos, size, t->tm_hour, 2, '0');
+        break;
+      case OP_HOUR12:
+        pos = put_number(buf, pos, size, (t->tm_hour + 11) % 12 + 1, 2, '0');
+        break;
+      case OP_AMPM:
+        pos = put_string(buf, pos, size, t->tm_hour < 12 ? "AM" : "PM");
+        break;
+      case OP_MINUTE:
+        pos = put_number(buf, pos, size, t->tm_min, 2, '0');
+        break;
+      case OP_SECOND:
+        pos = put_number(buf, pos, size, t->tm_sec, 2, '0');
+        break;
+      case OP_EPOCH:
+        pos = put_number(buf, pos, size, epoch, 0, '0');
+        break;
+    }
+  }
+
+  buf[pos] = '\0';
+  return pos;
+}
@@ -0,0 +1,38 @@
+/*
+ * Pebble Term Watch
+ *
+ * date +FORMAT plans.
+ * A format string is compiled once into a list of ops that emit only the
+ * fields it uses, along with the time units its output depends on.
+ */
+#pragma once
+
+#include <pebble.h>
+
+// A line shows 17 columns and "pebble>date +" takes 13 of them
+#define TERM_FORMAT_MAX_LEN (4)
+// longest output a format may have (the line buffer, less the NUL)
+#define TERM_FORMAT_MAX_WIDTH (16)
+#define TERM_FORMAT_MAX_OPS (24)
+
+typedef struct {
+  uint8_t code;
+  char literal;
+} FormatOp;
+
+typedef struct {
+  FormatOp ops[TERM_FORMAT_MAX_OPS];
+  uint8_t count;
+  uint8_t width;  // longest output
+  TimeUnits units;
+} FormatPlan;
+
+// Compiles fmt into plan, leaves plan untouched if fmt is not supported
+// or longer than TERM_FORMAT_MAX_LEN, or its output could be wider than
+// TERM_FORMAT_MAX_WIDTH.
+// Supports %Y %y %m %b %d %e %j %a %u %H %I %p %M %S %s %F %T %R %D %%
+bool term_format_compile(const char *fmt, FormatPlan *plan);
+
+// Renders plan into buf (always NUL terminated), epoch is used for %s
+size_t term_format_render(const FormatPlan *plan, const struct tm *t,
+                          uint32_t epoch, char *buf, size_t size);
@@ -0,0 +1,93 @@
+/*
+ * Pebble Term Watch
+ *
+ * Compact event trace recorder.
+ *
+ * Record layout (little endian):
+ *   uint16 dt   milliseconds since the previous record (saturated)
+ *   uint8  type TraceEvent
+ *   uint8  arg
+ *   uint8  len
+ *
+ * Chunk layout: uint8 index, uint8 count, records (oldest first).
+ */
+#include <pebble.h>
+#include "term_trace.h"
+
+static uint8_t trace_ring[TRACE_MAX_RECORDS * TRACE_RECORD_SIZE];
+static uint8_t trace_head = 0;
+static uint8_t trace_count = 0;
+static bool trace_paused = false;
+
+static time_t trace_last_sec = 0;
+static uint16_t trace_last_ms = 0;
+
+void trace_record(TraceEvent type, uint8_t arg, uint8_t len) {
+  if (trace_paused) {
+    return;
+  }
+
+  time_t sec;
+  uint16_t ms;
+  time_ms(&sec, &ms);
+
+  uint32_t dt = 0;
+  if (trace_last_sec != 0) {
+    dt = (uint32_t)(sec - trace_last_sec) * 1000 + ms - trace_last_ms;
+    if (dt > 0xFFFF) {
+      dt = 0xFFFF;
+    }
+  }
+  trace_last_sec = sec;
+  trace_last_ms = ms;
+
+  uint8_t *rec = &trace_ring[trace_head * TRACE_RECORD_SIZE];
+  rec[0] = (uint8_t)(dt & 0xFF);
+  rec[1] = (uint8_t)(dt >> 8);
+  rec[2] = (uint8_t)type;
+  rec[3] = arg;
+  rec[4] = len;
+
+  if (++trace_head == TRACE_MAX_RECORDS) {
+    trace_head = 0;
+  }
+  if (trace_count < TRACE_MAX_RECORDS) {
+    trace_count++;
+  }
+}
+
+uint8_t trace_result_code(AppMessageResult result) {
+  uint8_t code = 0;
+
+  while (result != 0) {
+    result >>= 1;
+    code++;
+  }
+  return code;
+}
+
+uint8_t trace_dump_begin(void) {
+  trace_paused = true;
+  return (trace_count + TRACE_CHUNK_RECORDS - 1) / TRACE_CHUNK_RECORDS;
+}
+
+size_t trace_dump_chunk(uint8_t index, uint8_t *out) {
+  uint8_t count = (trace_count + TRACE_CHUNK_RECORDS - 1) / TRACE_CHUNK_RECORDS;
+  uint8_t oldest = (trace_head + TRACE_MAX_RECORDS - trace_count) % TRACE_MAX_RECORDS;
+  size_t size = 2;
+
+  out[0] = index;
+  out[1] = count;
+
+  for (int i = index * TRACE_CHUNK_RECORDS;
+       i < trace_count && i < (index + 1) * TRACE_CHUNK_RECORDS; i++) {
+    uint8_t pos = (oldest + i) % TRACE_MAX_RECORDS;
+    memcpy(out + size, &trace_ring[pos * TRACE_RECORD_SIZE], TRACE_RECORD_SIZE);
+    size += TRACE_RECORD_SIZE;
+  }
+  return size;
+}
+
+void trace_dump_end(void) {
+  trace_paused = false;
+}
@@ -0,0 +1,46 @@
+/*
+ * Pebble Term Watch
+ *
+ * Compact event trace recorder.
+ * Fixed-size ring of 5 byte records, dumped to the phone on request.
+ * Without sync nothing can ask for it: term_trace.c is left out of those
+ * profiles and recording compiles to nothing.
+ */
+#pragma once
+
+#include <pebble.h>
+#include "term_features.h"
+
+#define TRACE_MAX_RECORDS (48)
+#define TRACE_RECORD_SIZE (5)
+#define TRACE_CHUNK_RECORDS (8)
+#define TRACE_CHUNK_SIZE (2 + TRACE_CHUNK_RECORDS * TRACE_RECORD_SIZE)
+
+typedef enum {
+  TRACE_NONE = 0,
+  TRACE_TICK = 1,      // arg: tm_sec, len: units changed
+  TRACE_TIMER = 2,     // arg: animation state
+  TRACE_FEED_END = 3,  // arg: feed_title_sending
+  TRACE_TUPLE = 4,     // arg: key, len: tuple length
+  TRACE_BATTERY = 5,   // arg: percent, len: charging
+  TRACE_BLUETOOTH = 6, // arg: connected
+  TRACE_SEND = 7,      // arg: message type, len: result bit (0 = APP_MSG_OK)
+  TRACE_RESET = 8      // arg: animation state, len: initTime
+} TraceEvent;
+
+#if TERM_FEATURE_SYNC
+void trace_record(TraceEvent type, uint8_t arg, uint8_t len);
+
+// Encodes an AppMessageResult as a single byte (bit index + 1, 0 for OK)
+uint8_t trace_result_code(AppMessageResult result);
+
+// Number of chunks in the current dump (recording pauses until the end)
+uint8_t trace_dump_begin(void);
+
+// Copies the chunk into out (TRACE_CHUNK_SIZE bytes), returns bytes written
+size_t trace_dump_chunk(uint8_t index, uint8_t *out);
+
+void trace_dump_end(void);
+#else
+static inline void trace_record(TraceEvent type, uint8_t arg, uint8_t len) {}
+#endif
@@ -0,0 +1,151 @@
+#
+# Generates what the SDK build would generate, for the host builds and
+# the Node harness under test/:
+#   OUTDIR/message_keys.h
+#   OUTDIR/js/message_keys.js, OUTDIR/js/settings_page.js
+#   OUTDIR/resource_ids.auto.h     ids from appinfo.json
+#   OUTDIR/resource_data.auto.h    the PNGs as 1 bit GBitmap rows (sdk/pebble.c)
+#
+# Usage: python test/generate.py OUTDIR [feature,...]
+#   features as in PROFILES in tools/profiles.py, all of them by default
+#
+
+import json
+import os
+import struct
+import sys
+import zlib
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+sys.path.insert(0, os.path.join(ROOT, 'tools'))
+
+import message_keys
+import settings_page
+from profiles import FEATURES
+
+
+def write(path, text):
+    if not os.path.isdir(os.path.dirname(path)):
+        os.makedirs(os.path.dirname(path))
+    # unchanged files keep their time stamp, make has nothing to redo
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == text:
+                return
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def png_bitmap(path):
+    """Decodes a non-interlaced PNG into Pebble GBitmap rows: 1 bit per
+    pixel, least significant bit first, rows padded to 4 bytes, 1 = white."""
+    with open(path, 'rb') as f:
+        png = f.read()
+
+    pos = 8
+    idat = b''
+    palette = None
+    while pos < len(png):
+        length, kind = struct.unpack('>I4s', png[pos:pos + 8])
+        chunk = png[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b'IHDR':
+            width, height, depth, color, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+        elif kind == b'PLTE':
+            palette = [tuple(bytearray(chunk[i:i + 3])) for i in range(0, len(chunk), 3)]
+        elif kind == b'IDAT':
+            idat += chunk
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    if interlace or (depth < 8 and color != 3 and color != 0):
+        raise ValueError('%s: unsupported PNG layout' % path)
+
+    bits = depth * channels
+    stride = (width * bits + 7) // 8
+    step = max(1, bits // 8)
+    raw = bytearray(zlib.decompress(idat))
+    rows = []
+    prev = bytearray(stride)
+
+    for y in range(height):
+        kind = raw[y * (stride + 1)]
+        line = raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)]
+        for i in range(stride):
+            a = line[i - step] if i >= step else 0
+            b = prev[i]
+            c = prev[i - step] if i >= step else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xff
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xff
+            elif kind == 3:
+                line[i] = (line[i] + (a + b) // 2) & 0xff
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                line[i] = (line[i] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 0xff
+        rows.append(line)
+        prev = line
+
+    def sample(line, x):
+        if depth < 8:
+            v = (line[x * depth // 8] >> (8 - depth - (x * depth) % 8)) & ((1 << depth) - 1)
+            return palette[v] if color == 3 else (v * 255 // ((1 << depth) - 1),) * 3
+        v = line[x * step:x * step + step]
+        return palette[v[0]] if color == 3 else (tuple(v[:3]) if channels >= 3 else (v[0],) * 3)
+
+    row_size = (width + 31) // 32 * 4
+    data = bytearray(row_size * height)
+    for y, line in enumerate(rows):
+        for x in range(width):
+            r, g, b = sample(line, x)[:3]
+            if r * 299 + g * 587 + b * 114 >= 128000:
+                data[y * row_size + x // 8] |= 1 << (x % 8)
+    return width, height, row_size, bytes(data)
+
+
+def resources(appinfo):
+    media = appinfo['resources']['media']
+    ids = ['  RESOURCE_ID_%s = %d' % (m['name'], i + 1) for i, m in enumerate(media)]
+    header = '\n'.join([
+        '// Generated from appinfo.json by test/generate.py. Do not edit.',
+        '#pragma once', '',
+        'enum {', ',\n'.join(ids), '};', '',
+        '#define RESOURCE_COUNT (%d)' % len(media), ''])
+
+    entries = []
+    for m in media:
+        if m['type'] != 'png':
+            entries.append('  { 0, 0, 0, NULL }')
+            continue
+        width, height, row_size, data = png_bitmap(
+            os.path.join(ROOT, 'resources', m['file']))
+        entries.append('  { %d, %d, %d, (const uint8_t []){ %s } }' % (
+            width, height, row_size, ', '.join('0x%02x' % b for b in bytearray(data))))
+    data = '\n'.join([
+        '// Generated from appinfo.json by test/generate.py. Do not edit.',
+        '// width, height, row size, rows (by resource id - 1, fonts empty)',
+        '#pragma once', '',
+        'static const SdkResource sdk_resources[RESOURCE_COUNT] = {',
+        ',\n'.join(entries), '};', ''])
+    return header, data
+
+
+def main(out, features):
+    schema = message_keys.select(
+        message_keys.load(os.path.join(ROOT, 'message_keys.json')), features)
+
+    write(os.path.join(out, 'message_keys.h'), message_keys.c_header(schema))
+    write(os.path.join(out, 'js', 'message_keys.js'), message_keys.js_source(schema))
+    write(os.path.join(out, 'js', 'settings_page.js'), settings_page.js_source(schema))
+
+    with open(os.path.join(ROOT, 'appinfo.json')) as f:
+        header, data = resources(json.load(f))
+    write(os.path.join(out, 'resource_ids.auto.h'), header)
+    write(os.path.join(out, 'resource_data.auto.h'), data)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.exit('usage: generate.py OUTDIR [feature,...]')
+    main(sys.argv[1], sys.argv[2].split(',') if len(sys.argv) > 2 else FEATURES)
@@ -0,0 +1,35 @@
+/*
+ * Pebble Term Watch
+ *
+ * feed_unpack for test/js/codec_corpus.js: one packed headline per line
+ * (hex) in, the decoded text out, into a buffer of SIZE bytes like the
+ * watch's (FEED_MAX_TITLE_LEN + 1).
+ *
+ *   codec_test [SIZE] < packed > text
+ */
+#include <pebble.h>
+#include "feed_codec.h"
+
+#define LINE_SIZE (1024)
+
+int main(int argc, char **argv) {
+  char line[LINE_SIZE];
+  uint8_t data[LINE_SIZE / 2];
+  size_t size = argc > 1 ? (size_t)atoi(argv[1]) : 141;
+  char *out = malloc(size + 1);
+
+  while (fgets(line, sizeof(line), stdin)) {
+    size_t length = 0;
+    unsigned int byte;
+
+    while (length < sizeof(data) && sscanf(line + length * 2, "%2x", &byte) == 1) {
+      data[length++] = (uint8_t)byte;
+    }
+
+    feed_unpack(data, length, out, size);
+    puts(out);
+  }
+
+  free(out);
+  return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * Pebble Term Watch
+ *
+ * fixed_math.h against the float arithmetic it replaces.
+ *
+ *   fixed_math_test        exits non-zero on the first failures
+ */
+#include <pebble.h>
+#include "fixed_math.h"
+
+static int failures = 0;
+
+#define CHECK_EQ(actual, expected) do { \
+  long a_ = (long)(actual), e_ = (long)(expected); \
+  if (a_ != e_) { \
+    fprintf(stderr, "%s:%d: %s is %ld, expected %ld\n", __FILE__, __LINE__, #actual, a_, e_); \
+    failures++; \
+  } \
+} while (0)
+
+// the battery gauge: percent * width / 100 as the float cast did
+static void test_scale(void) {
+  for (int32_t width = 0; width <= 144; width++) {
+    for (int32_t percent = 0; percent <= 100; percent++) {
+      CHECK_EQ(fx_scale(percent, width, 100), (int32_t)((float)percent * width / 100));
+    }
+  }
+
+  CHECK_EQ(fx_scale(-7, 3, 2), -10);
+  CHECK_EQ(fx_scale(7, -3, 2), -10);
+  CHECK_EQ(fx_scale(5, 1, 0), 0);
+}
+
+int main(void) {
+  test_scale();
+
+  if (failures) {
+    fprintf(stderr, "fixed_math_test: %d failures\n", failures);
+    return 1;
+  }
+  puts("fixed_math_test: ok");
+  return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * Pebble Term Watch
+ *
+ * The watchface built for Linux against the stand-in SDK (test/sdk),
+ * driven one line at a time by the phone side (test/js/link.js).
+ *
+ *   watch_host IN OUT START_MS [-p PERSIST]     (- for stdin / stdout)
+ *
+ * Every command starts with the virtual time it happens at; timers and
+ * ticks due before it run first.
+ *
+ *   T t              run until t
+ *   I t HEX          AppMessage from the phone        -> a | n
+ *   A t / X t        the phone acked / nacked the message in flight
+ *   B t 0|1          bluetooth disconnected / connected
+ *   P t PCT 0|1      battery percent, charging
+ *   K t              wrist tap
+ *   Q t PATH         screenshot (PBM)
+ *   S t              screen text                      -> S TEXT, a line per layer
+ *   C t              counters                         -> C key=value ...
+ *   E t              exit, persistent storage is saved
+ *
+ * While running the watch writes
+ *
+ *   O HEX            AppMessage to the phone (one in flight)
+ *   V KIND           vibration
+ *   L TEXT           APP_LOG line
+ *
+ * and every reply ends with ". NEXT", the next timer or tick deadline
+ * (-1 if none), so the phone side knows when to come back.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pebble.h>
+#include <inttypes.h>
+#include "sdk_host.h"
+
+// 656 byte inbox as hex plus the command
+#define LINE_SIZE (4096)
+
+int term_watch_main(void);
+
+static FILE *in;
+static FILE *out;
+static const char *persist_path = NULL;
+
+static void put_hex(const uint8_t *data, uint16_t size) {
+  for (uint16_t i = 0; i < size; i++) {
+    fprintf(out, "%02x", data[i]);
+  }
+}
+
+static int get_hex(const char *hex, uint8_t *data, int size) {
+  int len = 0;
+  unsigned int byte;
+
+  while (len < size && sscanf(hex + len * 2, "%2x", &byte) == 1) {
+    data[len++] = (uint8_t)byte;
+  }
+  return len;
+}
+
+static void on_outbox(const uint8_t *data, uint16_t size) {
+  fputs("O ", out);
+  put_hex(data, size);
+  fputc('\n', out);
+}
+
+static void on_vibe(const char *kind) {
+  fprintf(out, "V %s\n", kind);
+}
+
+static void on_log(const char *line) {
+  fprintf(out, "L %s\n", line);
+}
+
+// newlines escaped as in C, a layer per line
+static void put_text(const char *text) {
+  fputs("S ", out);
+  for (; *text; text++) {
+    if (*text == '\n') {
+      fputs("\\n", out);
+    } else {
+      fputc(*text, out);
+    }
+  }
+  fputc('\n', out);
+}
+
+static void put_counters(void) {
+  const SdkCounters *c = &sdk_counters;
+
+  fprintf(out, "C wakeups=%" PRIu32 " timers=%" PRIu32 " ticks=%" PRIu32
+          " frames=%" PRIu32 " glyphs=%" PRIu32 " text_sets=%" PRIu32
+          " dirty=%" PRIu32 " inbox=%" PRIu32 " inbox_bytes=%" PRIu32
+          " inbox_dropped=%" PRIu32 " outbox=%" PRIu32 " outbox_bytes=%" PRIu32
+          " outbox_busy=%" PRIu32 " outbox_failed=%" PRIu32
+          " persist_writes=%" PRIu32 " persist_bytes=%" PRIu32 " vibes=%" PRIu32
+          " app_ns=%" PRIu64 " render_ns=%" PRIu64
+          " first_frame_ms=%" PRId64 " first_frame_ns=%" PRIu64 " log_ns=%" PRIu64 "\n",
+          c->wakeups, c->timers, c->ticks, c->frames, c->glyphs, c->text_sets,
+          c->dirty, c->inbox, c->inbox_bytes, c->inbox_dropped, c->outbox,
+          c->outbox_bytes, c->outbox_busy, c->outbox_failed, c->persist_writes,
+          c->persist_bytes, c->vibes, c->app_ns, c->render_ns,
+          c->first_frame_ms, c->first_frame_ns, c->log_ns);
+}
+
+static void reply_end(void) {
+  uint64_t next = sdk_next_deadline();
+
+  if (next == UINT64_MAX) {
+    fputs(". -1\n", out);
+  } else {
+    fprintf(out, ". %" PRIu64 "\n", next);
+  }
+  fflush(out);
+}
+
+// Runs the commands until E or the end of the input
+static void event_loop(void) {
+  char line[LINE_SIZE];
+  static uint8_t data[LINE_SIZE / 2];
+
+  // launch: what init drew and sent
+  reply_end();
+
+  while (fgets(line, sizeof(line), in)) {
+    char command;
+    uint64_t t;
+    int n = 0;
+
+    if (sscanf(line, "%c %" SCNu64 " %n", &command, &t, &n) < 2) {
+      fprintf(stderr, "watch_host: bad command: %s", line);
+      reply_end();
+      continue;
+    }
+
+    char *arg = line + n;
+    arg[strcspn(arg, "\n")] = '\0';
+    sdk_run_until(t);
+
+    switch (command) {
+      case 'T':
+        break;
+      case 'I': {
+        int size = get_hex(arg, data, sizeof(data));
+        fputs(sdk_inbox(data, (uint16_t)size) ? "a\n" : "n\n", out);
+        break;
+      }
+      case 'A':
+      case 'X':
+        sdk_outbox_result(command == 'A');
+        break;
+      case 'B':
+        sdk_bluetooth(atoi(arg) != 0);
+        break;
+      case 'P': {
+        int percent = 0, charging = 0;
+        sscanf(arg, "%d %d", &percent, &charging);
+        sdk_battery((uint8_t)percent, charging != 0);
+        break;
+      }
+      case 'K':
+        sdk_tap();
+        break;
+      case 'Q':
+        if (!sdk_screenshot(arg)) {
+          fprintf(stderr, "watch_host: cannot write %s\n", arg);
+        }
+        break;
+      case 'S':
+        sdk_screen_text(put_text);
+        break;
+      case 'C':
+        put_counters();
+        break;
+      case 'E':
+        return;
+      default:
+        fprintf(stderr, "watch_host: unknown command %c\n", command);
+        break;
+    }
+    reply_end();
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s IN OUT START_MS [-p PERSIST]\n", argv[0]);
+    return 2;
+  }
+
+  in = strcmp(argv[1], "-") ? fopen(argv[1], "r") : stdin;
+  out = strcmp(argv[2], "-") ? fopen(argv[2], "w") : stdout;
+  if (in == NULL || out == NULL) {
+    perror("watch_host");
+    return 1;
+  }
+  if (argc > 5 && strcmp(argv[4], "-p") == 0) {
+    persist_path = argv[5];
+  }
+
+  SdkHooks hooks = {
+    .outbox = on_outbox,
+    .vibe = on_vibe,
+    .log = on_log,
+    .event_loop = event_loop
+  };
+
+  sdk_init(strtoull(argv[3], NULL, 10), &hooks);
+  if (persist_path) {
+    sdk_persist_load(persist_path);
+  }
+
+  term_watch_main();
+
+  // after deinit
+  reply_end();
+  if (persist_path && !sdk_persist_save(persist_path)) {
+    perror(persist_path);
+  }
+  return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Pebble Term Watch
+ *
+ * Round trip of the packed headline encoding: Codec.pack in the phone
+ * script against feed_unpack on the watch (codec_test, built by
+ * test/Makefile), over formatted feed headlines and edge cases, and the
+ * bytes the packing saves on the wire.
+ *
+ * Usage: node test/js/codec_corpus.js [--codec PATH] [--count N] [--json]
+ *
+ * Exits non-zero if a decoder disagrees with the original title or a
+ * packed title does not fit the feedPacked inbox size.
+ */
+
+'use strict';
+
+var childProcess = require('child_process');
+var fs = require('fs');
+var path = require('path');
+
+var Harness = require('./harness').Harness;
+var FeedServer = require('./feed_server').FeedServer;
+var watchUnpack = require('./watch_model').unpack;
+
+var ROOT = path.join(__dirname, '..', '..');
+var CODEC = path.join(ROOT, 'test', 'build', 'full', 'codec_test');
+// FEED_MAX_TITLE_LEN + 1 in pebble_term_watch.c
+var BUFFER_SIZE = 141;
+
+var args = process.argv.slice(2);
+var arg = function(name, def) {
+  var i = args.indexOf(name);
+  return i !== -1 ? args[i + 1] : def;
+};
+
+var modules = new Harness().load().modules;
+var Codec = modules.Codec;
+var Feed = modules.Feed;
+var inbox = JSON.parse(fs.readFileSync(path.join(ROOT, 'message_keys.json'), 'utf8'))
+  .keys.filter(function(key) {
+    return key.name === 'feedPacked';
+  })[0].in;
+
+var repeat = function(s, n) {
+  return new Array(n + 1).join(s);
+};
+
+// where the encoder has choices to make or the bits run out
+var edges = function() {
+  var ascii = '';
+
+  for (var c = 0x20; c <= 0x7e; c++) {
+    ascii += String.fromCharCode(c);
+  }
+
+  return [
+    '', 'a', '~', ' ', 'ab', 'abcdefg', 'abcdefgh', 'abcdefghi',
+    ascii,
+    ascii.slice(0, 60),
+    Codec.DICT.join(''),
+    Codec.DICT.join('|'),
+    'Applerelease', 'theand', ' the the the ', 'tionstions',
+    'security update', 'Microsoft\'s new iPhone',
+    repeat('~', Feed.TITLE_MAX_LEN - 1),
+    repeat(' the', 29),
+    repeat('security', 14),
+    // left to the cstring
+    'Caf\u00e9', 'tab\there'
+  ].concat(Codec.DICT);
+};
+
+var corpus = function(count) {
+  var server = new FeedServer({ size: 1, fresh: 1 });
+  var titles = [];
+
+  // every headline the server would publish, formatted as on the phone
+  for (var n = 0; n < count; n++) {
+    titles.push(Feed.prototype.format.call(null, server.headline(n)));
+  }
+  return titles.concat(edges());
+};
+
+var titles = corpus(+arg('--count', 500));
+var packed = titles.map(function(title) {
+  return Codec.pack(title);
+});
+var packable = titles.filter(function(title, i) {
+  return packed[i] !== null;
+});
+var bytes = packed.filter(function(b) {
+  return b !== null;
+});
+
+var decoded = childProcess.execFileSync(arg('--codec', CODEC), ['' + BUFFER_SIZE], {
+  input: bytes.map(function(b) {
+    return Buffer.from(b).toString('hex');
+  }).join('\n') + '\n'
+}).toString('latin1').split('\n');
+
+var failures = [];
+var report = {
+  titles: titles.length,
+  packable: packable.length,
+  sentPacked: 0,
+  cstringBytes: 0,
+  sentBytes: 0,
+  maxPacked: 0,
+  inbox: inbox
+};
+
+titles.forEach(function(title, i) {
+  var cstring = title.length + 1;
+
+  report.cstringBytes += cstring;
+  if (packed[i] && packed[i].length < cstring) {
+    // as Feed.deliver chooses
+    report.sentPacked++;
+    report.sentBytes += packed[i].length;
+  } else {
+    report.sentBytes += cstring;
+  }
+});
+
+packable.forEach(function(title, i) {
+  var results = {
+    watch: decoded[i],
+    js: Codec.unpack(bytes[i]),
+    model: watchUnpack(bytes[i])
+  };
+  // the watch cuts what does not fit its buffer
+  var expected = {
+    watch: title.slice(0, BUFFER_SIZE - 1),
+    js: title,
+    model: title
+  };
+
+  report.maxPacked = Math.max(report.maxPacked, bytes[i].length);
+
+  Object.keys(results).forEach(function(name) {
+    if (results[name] !== expected[name]) {
+      failures.push(name + ': ' + JSON.stringify(title) + ' -> ' + JSON.stringify(results[name]));
+    }
+  });
+  if (bytes[i].length > inbox) {
+    failures.push('feedPacked: ' + bytes[i].length + ' > ' + inbox + ' bytes: ' +
+                  JSON.stringify(title));
+  }
+});
+
+report.saved = report.cstringBytes - report.sentBytes;
+report.failures = failures;
+
+if (args.indexOf('--json') !== -1) {
+  console.log(JSON.stringify(report, null, 2));
+} else {
+  console.log('titles:         ' + report.titles + ' (' + report.packable + ' printable ASCII)');
+  console.log('sent packed:    ' + report.sentPacked);
+  console.log('bytes:          ' + report.sentBytes + ' sent, ' + report.cstringBytes +
+              ' as cstrings (' + report.saved + ' saved, ' +
+              (100 * report.saved / report.cstringBytes).toFixed(1) + '%)');
+  console.log('largest packed: ' + report.maxPacked + ' of ' + inbox + ' bytes');
+  failures.forEach(function(line) {
+    console.error('mismatch ' + line);
+  });
+}
+
+process.exit(failures.length ? 1 : 0);
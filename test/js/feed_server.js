@@ -0,0 +1,131 @@
+/*
+ * Pebble Term Watch
+ *
+ * Stand-in feed server for the harness: an RSS feed (or the compact list
+ * of tools/feed_proxy.py) whose newest headlines change every period.
+ *
+ *   new FeedServer({ period: 20 * 60 * 1000, fresh: 3, latency: 300 })
+ *
+ * Responses carry an ETag, a matching If-None-Match gets 304. Requests
+ * inside an outage ([from, to] ms since the first request) fail like a
+ * dropped connection.
+ */
+
+'use strict';
+
+var WORDS = [
+  'Apple', 'Google', 'Microsoft', 'Android', 'iPhone', 'security', 'update',
+  'release', 'the', 'and', 'for', 'with', 'from', 'after', 'says', 'new',
+  'battery', 'watch', 'market', 'report', 'court', 'launch', 'outage',
+  'network', 'chip', 'startup', 'shares', 'rally', 'study', 'climate',
+  'election', 'storm', 'bank', 'rates', 'deal', 'tests', 'patch', 'kernel'
+];
+
+// titles the watch cannot show as is (format and toAscii have work to do)
+var UNICODE = [
+  'Café owners — “prices” up again',
+  'Naïve résumé tips for the new year',
+  '東京: markets open higher',
+  'München wins ½ of the derby'
+];
+
+var FeedServer = exports.FeedServer = function(options) {
+  options = options || {};
+
+  this.period = options.period || 20 * 60 * 1000;
+  this.fresh = options.fresh || 3;
+  this.size = options.size || 10;
+  this.latency = options.latency === void 0 ? 300 : options.latency;
+  this.compact = !!options.compact;
+  this.outages = options.outages || [];
+  this.seed = options.seed || 1;
+  this.start = null;
+  this.requests = 0;
+  this.notModified = 0;
+  this.failures = 0;
+  this.headlines = [];
+  this.published = 0;
+  this.generation = -1;
+};
+
+FeedServer.prototype = {
+  random: function() {
+    // LCG, the same feed on every run
+    this.seed = (this.seed * 1103515245 + 12345) & 0x7fffffff;
+    return this.seed / 0x80000000;
+  },
+  headline: function(n) {
+    if (n % 5 === 4) {
+      return UNICODE[(n / 5 | 0) % UNICODE.length] + ' #' + n;
+    }
+
+    var words = [];
+    var count = 5 + (this.random() * 10 | 0);
+
+    for (var i = 0; i < count; i++) {
+      words.push(WORDS[this.random() * WORDS.length | 0]);
+    }
+    return words.join(' ') + ' #' + n;
+  },
+  // newest first, fresh ones on top every period
+  update: function(now) {
+    var generation = Math.floor((now - this.start) / this.period);
+
+    while (this.generation < generation) {
+      this.generation++;
+      for (var i = 0; i < (this.generation ? this.fresh : this.size); i++) {
+        this.headlines.unshift(this.headline(this.published++));
+      }
+      this.headlines.length = Math.min(this.headlines.length, this.size);
+    }
+  },
+  rss: function() {
+    var escape = function(s) {
+      return s.replace(/&/g, '&amp;').replace(/</g, '&lt;').replace(/>/g, '&gt;');
+    };
+
+    return '<?xml version="1.0" encoding="UTF-8"?>\n' +
+      '<rss version="2.0"><channel><title>Stand-in</title>\n' +
+      this.headlines.map(function(title, i) {
+        // both ways feeds quote titles
+        var quoted = i % 2 ? '<![CDATA[' + title + ']]>' : escape(title);
+        return '<item><title>' + quoted + '</title><link>http://example.com/' +
+               i + '</link><description>&lt;p&gt;' + escape(title) +
+               '&lt;/p&gt;</description></item>';
+      }).join('\n') + '\n</channel></rss>\n';
+  },
+  handle: function(req, now) {
+    if (this.start === null) {
+      this.start = now;
+    }
+    this.requests++;
+
+    var t = now - this.start;
+    var down = this.outages.some(function(outage) {
+      return t >= outage[0] && t < outage[1];
+    });
+
+    if (down) {
+      this.failures++;
+      return { status: 0, statusText: '', latency: this.latency * 10 };
+    }
+
+    this.update(now);
+
+    var etag = '"g' + this.generation + '"';
+
+    if (req.headers['if-none-match'] === etag) {
+      this.notModified++;
+      return { status: 304, statusText: 'Not Modified', latency: this.latency,
+               headers: { ETag: etag } };
+    }
+
+    return {
+      status: 200,
+      statusText: 'OK',
+      latency: this.latency,
+      headers: { ETag: etag },
+      body: this.compact ? JSON.stringify({ items: this.headlines }) : this.rss()
+    };
+  }
+};
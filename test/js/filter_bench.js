@@ -0,0 +1,106 @@
+/*
+ * Pebble Term Watch
+ *
+ * Keyword filter cost against the number of keywords: the Aho-Corasick
+ * Matcher next to one indexOf per keyword, on the same normalized titles.
+ *
+ * Usage: node test/js/filter_bench.js [--json]
+ *
+ * Exits non-zero if the matchers disagree or Matcher._cache grows past
+ * Matcher.CACHE_MAX.
+ */
+
+'use strict';
+
+var Harness = require('./harness').Harness;
+var FeedServer = require('./feed_server').FeedServer;
+
+var COUNTS = [1, 4, 16, 64, 256];
+var ROUNDS = 200;
+
+var modules = new Harness().load().modules;
+var Matcher = modules.Matcher;
+
+// one refresh of a long feed, normalized once as onFilter does per title
+var server = new FeedServer({ size: 50, compact: true });
+var titles = JSON.parse(server.handle({ headers: {} }, 0).body).items;
+var texts = titles.map(Matcher.normalize);
+
+// words that mostly do not occur in the titles, plus one that does
+var keywords = function(count) {
+  var words = [];
+
+  for (var i = 0; i < count - 1; i++) {
+    words.push('kw' + i.toString(36) + 'x');
+  }
+  return words.concat('outage').join(',');
+};
+
+var time = function(fn) {
+  var start = process.hrtime.bigint();
+
+  for (var i = 0; i < ROUNDS; i++) {
+    fn();
+  }
+  return Number(process.hrtime.bigint() - start) / 1e3 / ROUNDS / titles.length;
+};
+
+var results = COUNTS.map(function(count) {
+  var list = keywords(count);
+  var words = list.split(',');
+  var matched = {};
+
+  // as onFilter does it, compiled once per refresh
+  var matcher = function() {
+    var include = Matcher.compile(list);
+    var exclude = Matcher.compile('');
+
+    return texts.filter(function(text) {
+      return include.test(text) && !exclude.test(text);
+    });
+  };
+
+  var naive = function() {
+    return texts.filter(function(text) {
+      return words.some(function(word) {
+        return text.indexOf(word) !== -1;
+      });
+    });
+  };
+
+  matched.matcher = matcher().length;
+  matched.naive = naive().length;
+
+  return {
+    keywords: count,
+    matched: matched.matcher,
+    agree: matched.matcher === matched.naive,
+    matcher: time(matcher),
+    naive: time(naive)
+  };
+});
+
+var failed = results.filter(function(r) {
+  return !r.agree;
+}).length;
+
+if (Matcher._cache.length > Matcher.CACHE_MAX) {
+  console.error('filter_bench: Matcher._cache holds ' + Matcher._cache.length + ' lists');
+  failed++;
+}
+
+if (process.argv.indexOf('--json') !== -1) {
+  console.log(JSON.stringify(results, null, 2));
+} else {
+  console.log('keywords  matched  matcher us/title  indexOf us/title');
+  results.forEach(function(r) {
+    console.log([
+      ('' + r.keywords).padStart(8),
+      ('' + r.matched).padStart(8),
+      r.matcher.toFixed(3).padStart(17),
+      r.naive.toFixed(3).padStart(17)
+    ].join(' ') + (r.agree ? '' : '  MISMATCH'));
+  });
+}
+
+process.exit(failed ? 1 : 0);
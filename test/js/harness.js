@@ -0,0 +1,476 @@
+/*
+ * Pebble Term Watch
+ *
+ * Headless harness for src/js/pebble-js-app.js.
+ *
+ * The app script runs in a vm context with mock Pebble, XMLHttpRequest,
+ * localStorage, DOMParser and timers on a virtual clock, so an hour of
+ * fetch cycles takes well under a second. Requests go to a stand-in feed
+ * server (feed_server.js) and messages to a watch endpoint
+ * (watch_model.js, or the real watchface through link.js).
+ *
+ *   var h = new Harness({ server: new FeedServer(), watch: new ScriptedWatch() });
+ *   h.load();
+ *   h.ready();
+ *   h.run(60 * 60 * 1000);
+ *   h.counters  // requests, storage reads/writes, wakeups, messages, cpu
+ */
+
+'use strict';
+
+var childProcess = require('child_process');
+var fs = require('fs');
+var path = require('path');
+var vm = require('vm');
+
+var ROOT = path.join(__dirname, '..', '..');
+var FEATURES = ['typing', 'status', 'sync', 'feed'];
+
+// 12:00:30 UTC, half a minute before a watch tick
+var START = Date.UTC(2026, 0, 1, 12, 0, 30);
+
+process.env.TZ = 'UTC';
+
+
+// Virtual clock: callbacks run in deadline order, time only moves
+// between them
+var Clock = exports.Clock = function(now) {
+  this.now = now;
+  this.queue = [];
+  this.seq = 0;
+  this.fired = {};
+};
+
+Clock.prototype = {
+  schedule: function(fn, ms, kind) {
+    var entry = {
+      id: ++this.seq,
+      at: this.now + Math.max(0, ms - 0 || 0),
+      fn: fn,
+      kind: kind || 'timer'
+    };
+    var i = this.queue.length;
+
+    while (i > 0 && this.queue[i - 1].at > entry.at) {
+      i--;
+    }
+    this.queue.splice(i, 0, entry);
+    return entry.id;
+  },
+  cancel: function(id) {
+    this.queue = this.queue.filter(function(entry) {
+      return entry.id !== id;
+    });
+  },
+  next: function() {
+    return this.queue.length ? this.queue[0].at : Infinity;
+  },
+  runUntil: function(until) {
+    while (this.queue.length && this.queue[0].at <= until) {
+      var entry = this.queue.shift();
+
+      this.now = entry.at;
+      this.fired[entry.kind] = (this.fired[entry.kind] || 0) + 1;
+      entry.fn();
+    }
+    if (until > this.now) {
+      this.now = until;
+    }
+  }
+};
+
+
+// Just enough XML for RSS: elements, text, CDATA and entities
+var ENTITIES = { amp: '&', lt: '<', gt: '>', quot: '"', apos: '\'' };
+
+var decodeEntities = function(s) {
+  return s.replace(/&(#x[0-9a-f]+|#\d+|\w+);/gi, function(m, name) {
+    if (name.charAt(0) === '#') {
+      return String.fromCharCode(name.charAt(1).toLowerCase() === 'x' ?
+                                 parseInt(name.slice(2), 16) : +name.slice(1));
+    }
+    return ENTITIES.hasOwnProperty(name) ? ENTITIES[name] : m;
+  });
+};
+
+var XmlElement = function(tagName) {
+  this.tagName = tagName;
+  this.childNodes = [];
+};
+
+XmlElement.prototype = {
+  get textContent() {
+    return this.childNodes.map(function(node) {
+      return typeof node === 'string' ? node : node.textContent;
+    }).join('');
+  },
+  getElementsByTagName: function(name) {
+    var found = [];
+
+    (function walk(element) {
+      element.childNodes.forEach(function(node) {
+        if (typeof node !== 'string') {
+          if (name === '*' || node.tagName === name) {
+            found.push(node);
+          }
+          walk(node);
+        }
+      });
+    }(this));
+    return found;
+  }
+};
+
+var parseXml = exports.parseXml = function(text) {
+  var doc = new XmlElement('#document');
+  var stack = [doc];
+  var re = /<!\[CDATA\[([\s\S]*?)\]\]>|<!--[\s\S]*?-->|<[?!][^>]*>|<\/\s*([^\s>]+)\s*>|<([^\s>\/]+)[^>]*?(\/?)>|([^<]+)/g;
+  var m;
+
+  while ((m = re.exec(text))) {
+    var top = stack[stack.length - 1];
+
+    if (m[1] !== void 0) {
+      top.childNodes.push(m[1]);
+    } else if (m[2] !== void 0) {
+      if (stack.length > 1) {
+        stack.pop();
+      }
+    } else if (m[3] !== void 0) {
+      var element = new XmlElement(m[3]);
+
+      top.childNodes.push(element);
+      if (!m[4]) {
+        stack.push(element);
+      }
+    } else if (m[5] !== void 0) {
+      top.childNodes.push(decodeEntities(m[5]));
+    }
+  }
+  return doc;
+};
+
+
+// Dictionary bytes on the wire: 1 byte count, 7 byte tuple headers,
+// numbers as int32, strings NUL terminated
+var dictSize = exports.dictSize = function(data) {
+  return Object.keys(data).reduce(function(size, key) {
+    var value = data[key];
+
+    if (typeof value === 'number') {
+      return size + 7 + 4;
+    }
+    if (Array.isArray(value)) {
+      return size + 7 + value.length;
+    }
+    return size + 7 + Buffer.byteLength('' + value) + 1;
+  }, 1);
+};
+
+
+// Generated sources (test/generate.py), as the SDK build bundles them
+var bundle = function(features, script) {
+  var out = path.join(ROOT, 'test', 'build', 'gen-' + features.join('-'));
+
+  childProcess.execFileSync('python3', [
+    path.join(ROOT, 'test', 'generate.py'), out, features.join(',')
+  ]);
+
+  return ['message_keys.js', 'settings_page.js'].map(function(name) {
+    return fs.readFileSync(path.join(out, 'js', name), 'utf8');
+  }).concat(fs.readFileSync(script, 'utf8')).join('\n');
+};
+
+
+var Harness = exports.Harness = function(options) {
+  options = options || {};
+
+  this.options = options;
+  this.clock = new Clock(options.start || START);
+  this.server = options.server || null;
+  this.watch = options.watch || null;
+  this.storage = Object.assign({}, options.storage || {});
+  this.listeners = {};
+  this.immediates = [];
+  this.logs = [];
+  this.urls = [];
+  this.errors = [];
+  this.counters = {
+    load: 0,       // ms evaluating the script (host time)
+    cpu: 0,        // ms in its event handlers and timers after that
+    requests: 0,
+    storageReads: 0,
+    storageWrites: 0,
+    wakeups: 0,    // app timers fired
+    messages: 0,   // sent to the watch
+    bytes: 0,
+    received: 0    // from the watch
+  };
+  this.modules = null;
+};
+
+Harness.prototype = {
+  now: function() {
+    return this.clock.now;
+  },
+  // Runs fn as one turn of the phone's event loop, timed
+  enter: function(fn) {
+    var time = process.hrtime.bigint();
+
+    try {
+      fn();
+      while (this.immediates.length) {
+        this.immediates.shift()();
+      }
+    } catch (e) {
+      this.errors.push(e);
+      if (!this.options.keepGoing) {
+        throw e;
+      }
+    } finally {
+      this.counters.cpu += Number(process.hrtime.bigint() - time) / 1e6;
+    }
+  },
+  log: function(line) {
+    if (this.options.verbose) {
+      console.log('[%s] %s', new Date(this.clock.now).toISOString().slice(11, 23), line);
+    }
+    this.logs.push(line);
+  },
+  context: function() {
+    var self = this;
+    var clock = this.clock;
+    var storage = this.storage;
+    var counters = this.counters;
+
+    var VDate = class extends Date {
+      constructor() {
+        if (arguments.length) {
+          super(...arguments);
+        } else {
+          super(clock.now);
+        }
+      }
+      static now() {
+        return clock.now;
+      }
+    };
+
+    var timer = function(fn, ms) {
+      var args = Array.prototype.slice.call(arguments, 2);
+
+      return clock.schedule(function() {
+        counters.wakeups++;
+        self.enter(function() {
+          fn.apply(null, args);
+        });
+      }, ms, 'timer');
+    };
+
+    var XMLHttpRequest = function() {
+      this.readyState = 0;
+      this.status = 0;
+      this.statusText = '';
+      this.responseText = '';
+      this._request = { headers: {} };
+      this._headers = {};
+    };
+
+    XMLHttpRequest.prototype = {
+      open: function(method, url) {
+        this._request.method = method;
+        this._request.url = url;
+        this.readyState = 1;
+      },
+      setRequestHeader: function(name, value) {
+        this._request.headers[name.toLowerCase()] = '' + value;
+      },
+      getResponseHeader: function(name) {
+        var value = this._headers[name.toLowerCase()];
+        return value === void 0 ? null : value;
+      },
+      send: function() {
+        var xhr = this;
+        var res = self.server ? self.server.handle(this._request, clock.now) :
+                                { status: 0, latency: 0 };
+
+        counters.requests++;
+        clock.schedule(function() {
+          self.enter(function() {
+            xhr.readyState = 4;
+            xhr.status = res.status;
+            xhr.statusText = res.statusText || '';
+            xhr.responseText = res.body || '';
+            Object.keys(res.headers || {}).forEach(function(name) {
+              xhr._headers[name.toLowerCase()] = res.headers[name];
+            });
+
+            if (!res.status) {
+              if (xhr.onerror) {
+                xhr.onerror({});
+              }
+            } else if (xhr.onload) {
+              xhr.onload({});
+            }
+          });
+        }, res.latency, 'io');
+      }
+    };
+
+    var localStorage = {
+      getItem: function(key) {
+        counters.storageReads++;
+        return hasKey(key) ? storage[key] : null;
+      },
+      setItem: function(key, value) {
+        counters.storageWrites++;
+        storage[key] = '' + value;
+      },
+      removeItem: function(key) {
+        counters.storageWrites++;
+        delete storage[key];
+      },
+      key: function(i) {
+        var keys = Object.keys(storage);
+        return i < keys.length ? keys[i] : null;
+      },
+      get length() {
+        return Object.keys(storage).length;
+      }
+    };
+
+    var hasKey = function(key) {
+      return Object.prototype.hasOwnProperty.call(storage, key);
+    };
+
+    var Pebble = {
+      addEventListener: function(name, fn) {
+        (self.listeners[name] = self.listeners[name] || []).push(fn);
+      },
+      sendAppMessage: function(data, ack, nack) {
+        counters.messages++;
+        counters.bytes += dictSize(data);
+
+        if (!self.watch) {
+          return;
+        }
+        self.watch.receive(JSON.parse(JSON.stringify(data)), function() {
+          if (ack) {
+            self.enter(function() {
+              ack({ data: {} });
+            });
+          }
+        }, function(reason) {
+          if (nack) {
+            self.enter(function() {
+              nack({ data: {}, error: { message: reason || 'nack' } });
+            });
+          }
+        });
+      },
+      openURL: function(url) {
+        self.urls.push(url);
+      },
+      showSimpleNotificationOnPebble: function() {}
+    };
+
+    var log = function() {
+      self.log(Array.prototype.slice.call(arguments).join(' '));
+    };
+
+    var ctx = {
+      console: { log: log, info: log, warn: log, error: log },
+      Date: VDate,
+      Pebble: Pebble,
+      XMLHttpRequest: XMLHttpRequest,
+      DOMParser: function() {
+        this.parseFromString = function(text) {
+          return parseXml(text);
+        };
+      },
+      localStorage: localStorage,
+      setTimeout: timer,
+      clearTimeout: function(id) {
+        clock.cancel(id);
+      },
+      setImmediate: function(fn) {
+        self.immediates.push(fn);
+      }
+    };
+
+    ctx.window = ctx;
+    return vm.createContext(ctx);
+  },
+  // Evaluates the bundled app script, as the phone does on launch
+  load: function() {
+    var self = this;
+    var features = this.options.features || FEATURES;
+    var script = this.options.script || path.join(ROOT, 'src', 'js', 'pebble-js-app.js');
+    var source = bundle(features, script);
+    var hook = '  var exports = {};';
+
+    // keep a handle on the module table for benchmarks of single modules
+    if (source.split(hook).length !== 2) {
+      throw new Error('module bootstrap not found in ' + script);
+    }
+    source = source.replace(hook, '  var exports = global.__modules = {};');
+
+    this.ctx = this.context();
+    this.enter(function() {
+      vm.runInContext(source, self.ctx, { filename: script });
+    });
+    // evaluation is reported apart from the event loop
+    this.counters.load = this.counters.cpu;
+    this.counters.cpu = 0;
+    this.modules = this.ctx.__modules;
+    this.keys = this.ctx.MESSAGE_KEYS;
+
+    if (this.watch) {
+      this.watch.attach(this);
+    }
+    return this;
+  },
+  emit: function(name, event) {
+    var self = this;
+
+    (this.listeners[name] || []).forEach(function(fn) {
+      self.enter(function() {
+        fn(event);
+      });
+    });
+  },
+  // events
+  ready: function() {
+    this.emit('ready', {});
+  },
+  // payload by key name, like PebbleKit JS with appKeys
+  appmessage: function(payload) {
+    this.counters.received++;
+    this.emit('appmessage', { payload: payload });
+  },
+  showConfiguration: function() {
+    this.emit('showConfiguration', {});
+  },
+  webviewclosed: function(response) {
+    this.emit('webviewclosed', { response: response });
+  },
+  // numeric keys from sendAppMessage to names
+  decode: function(data) {
+    var names = {};
+    var keys = this.keys || {};
+
+    Object.keys(keys).forEach(function(name) {
+      if (data.hasOwnProperty(keys[name])) {
+        names[name] = data[keys[name]];
+      }
+    });
+    return names;
+  },
+  run: function(ms) {
+    this.clock.runUntil(this.clock.now + ms);
+    return this;
+  },
+  stats: function() {
+    return this.modules.Stats.counters;
+  }
+};
@@ -0,0 +1,126 @@
+/*
+ * Pebble Term Watch
+ *
+ * Simulated hour of the phone side: the app script against the stand-in
+ * feed server and the watch model, on the virtual clock.
+ *
+ * Usage: node test/js/hour.js [--minutes N] [--pull] [--compact] [--json]
+ *
+ * Exits non-zero if the script throws or no headline reaches the watch.
+ */
+
+'use strict';
+
+var Harness = require('./harness').Harness;
+var FeedServer = require('./feed_server').FeedServer;
+var ScriptedWatch = require('./watch_model').ScriptedWatch;
+
+var FEED_URL = 'http://feeds.example.com/rss';
+
+// Runs the scenario, returns the numbers
+var simulate = exports.simulate = function(options) {
+  options = options || {};
+
+  var minutes = options.minutes || 60;
+  var server = options.server || new FeedServer({ compact: options.compact });
+  var watch = options.watch || new ScriptedWatch();
+  var settings = Object.assign({
+    feedUrl: FEED_URL,
+    feedInterval: 15 * 60,
+    pullMode: options.pull ? 1 : 0
+  }, options.settings || {});
+  var harness = new Harness({
+    features: options.features,
+    server: server,
+    watch: watch,
+    keepGoing: true,
+    verbose: options.verbose,
+    storage: { pebbleTerm: JSON.stringify(settings) }
+  });
+
+  harness.load();
+  // without sync the phone gets no app script, the watch runs alone
+  if (!options.features || options.features.indexOf('sync') !== -1) {
+    harness.ready();
+  }
+  harness.run(minutes * 60 * 1000);
+
+  var stats = harness.stats();
+  var counters = harness.counters;
+
+  return {
+    harness: harness,
+    minutes: minutes,
+    fetches: stats.fetches,
+    requests: server.requests,
+    notModified: server.notModified,
+    load: counters.load,
+    cpu: counters.cpu,
+    cpuPerFetch: stats.fetches ? counters.cpu / stats.fetches : 0,
+    storageReads: counters.storageReads,
+    storageWrites: counters.storageWrites,
+    timerWakeups: counters.wakeups,
+    messages: counters.messages,
+    bytes: counters.bytes,
+    pings: stats.pings,
+    wastedPings: stats.wastedPings,
+    extraWakes: stats.extraWakes,
+    held: stats.held,
+    packedSaved: stats.packedSaved,
+    headlines: watch.headlines.length,
+    watchWakeups: watch.counters.wakeups,
+    watchSent: watch.counters.sent,
+    watchBusy: watch.counters.busy,
+    errors: harness.errors.map(function(e) {
+      return e.stack || '' + e;
+    })
+  };
+};
+
+var format = exports.format = function(r) {
+  var lines = [
+    ['minutes', r.minutes],
+    ['fetch cycles', r.fetches + ' (' + r.requests + ' requests, ' + r.notModified + ' not modified)'],
+    ['script load', r.load.toFixed(1) + ' ms'],
+    ['cpu', r.cpu.toFixed(1) + ' ms, ' + r.cpuPerFetch.toFixed(2) + ' ms per fetch cycle'],
+    ['localStorage', r.storageReads + ' reads, ' + r.storageWrites + ' writes'],
+    ['timer wakeups', r.timerWakeups],
+    ['to the watch', r.messages + ' messages, ' + r.bytes + ' bytes (' + r.pings +
+                     ' pings, ' + r.wastedPings + ' wasted, ' + r.extraWakes + ' off tick)'],
+    ['packed', r.packedSaved + ' bytes saved'],
+    ['held', r.held],
+    ['headlines', r.headlines],
+    ['from the watch', r.watchSent + ' messages, ' + r.watchBusy + ' busy'],
+    ['watch wakeups', r.watchWakeups]
+  ];
+
+  return lines.map(function(line) {
+    return (line[0] + ':' + new Array(16).join(' ')).slice(0, 16) + line[1];
+  }).join('\n');
+};
+
+if (require.main === module) {
+  var args = process.argv.slice(2);
+  var minutes = args.indexOf('--minutes');
+  var result = simulate({
+    minutes: minutes !== -1 ? +args[minutes + 1] : 60,
+    pull: args.indexOf('--pull') !== -1,
+    compact: args.indexOf('--compact') !== -1,
+    verbose: args.indexOf('--verbose') !== -1
+  });
+
+  if (args.indexOf('--json') !== -1) {
+    delete result.harness;
+    console.log(JSON.stringify(result, null, 2));
+  } else {
+    console.log(format(result));
+  }
+
+  result.errors.forEach(function(error) {
+    console.error(error);
+  });
+  if (result.errors.length || !result.headlines) {
+    console.error(result.errors.length ? 'hour: script threw' : 'hour: no headline reached the watch');
+    process.exit(1);
+  }
+}
@@ -0,0 +1,567 @@
+/*
+ * Pebble Term Watch
+ *
+ * The phone script (harness.js) and the real watchface (watch_host, built
+ * by test/Makefile against the stand-in SDK) over a simulated AppMessage
+ * link, both on the harness clock.
+ *
+ *   new LinkWatch({ binary: 'test/build/full/watch_host', latency: 60,
+ *                   bandwidth: 2000, loss: 0.05, busy: 0.05,
+ *                   disconnects: [[from, to], ...] })   // ms from launch
+ *
+ * The link is half duplex: a message waits for the one on the air, takes
+ * size / bandwidth to send and latency to arrive; acks only take the
+ * latency. A lost message is nacked after the AppMessage timeout, a busy
+ * receiver nacks at once and nothing goes through while disconnected.
+ *
+ * Usage: node test/js/link.js [--minutes N] [--pull] [--compact]
+ *          [--latency MS] [--bandwidth BYTES/S] [--loss P] [--busy P]
+ *          [--disconnect FROM:TO (s)] [--seed N] [--watch PATH]
+ *          [--features LIST] [--screenshot PATH] [--json] [--verbose]
+ *
+ * --features is the profile of the watch_host (make -C test PROFILE=...),
+ * as a comma separated list; the phone script gets the same keys.
+ *
+ * Exits non-zero if the phone script throws, the watch drops a message
+ * or, with the feed, no headline reaches the watch.
+ */
+
+'use strict';
+
+var childProcess = require('child_process');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+var hour = require('./hour');
+var FeedServer = require('./feed_server').FeedServer;
+var unpack = require('./watch_model').unpack;
+
+var ROOT = path.join(__dirname, '..', '..');
+var BINARY = path.join(ROOT, 'test', 'build', 'full', 'watch_host');
+
+var MSG_TYPE_FEED_TITLE = 2;
+var MSG_TYPE_NAMES = {};
+var MSG_TYPES = JSON.parse(fs.readFileSync(path.join(ROOT, 'message_keys.json'), 'utf8')).msgTypes;
+
+Object.keys(MSG_TYPES).forEach(function(name) {
+  MSG_TYPE_NAMES[MSG_TYPES[name]] = name.toLowerCase().replace('_', ' ');
+});
+// AppMessage gives up on an unanswered message after this long
+var TIMEOUT = 3000;
+// and at once when there is no connection
+var NOT_CONNECTED = 100;
+
+var TUPLE_BYTE_ARRAY = 0;
+var TUPLE_CSTRING = 1;
+var TUPLE_UINT = 2;
+
+
+// Dictionary as PebbleKit JS writes it: keys in order, numbers as int32,
+// strings NUL terminated, arrays as bytes
+var encode = exports.encode = function(data) {
+  var keys = Object.keys(data);
+  var parts = [Buffer.from([keys.length])];
+
+  keys.forEach(function(key) {
+    var value = data[key];
+    var type, bytes;
+
+    if (typeof value === 'number' || typeof value === 'boolean') {
+      type = 3;
+      bytes = Buffer.alloc(4);
+      bytes.writeInt32LE(+value | 0);
+    } else if (Array.isArray(value)) {
+      type = TUPLE_BYTE_ARRAY;
+      bytes = Buffer.from(value);
+    } else {
+      type = TUPLE_CSTRING;
+      bytes = Buffer.concat([Buffer.from('' + value, 'utf8'), Buffer.from([0])]);
+    }
+
+    var header = Buffer.alloc(7);
+    header.writeUInt32LE(+key);
+    header.writeUInt8(type, 4);
+    header.writeUInt16LE(bytes.length, 5);
+    parts.push(header, bytes);
+  });
+  return Buffer.concat(parts);
+};
+
+// and back, numeric key to value
+var decode = exports.decode = function(bytes) {
+  var data = {};
+  var pos = 1;
+
+  for (var i = 0; i < bytes[0]; i++) {
+    var key = bytes.readUInt32LE(pos);
+    var type = bytes[pos + 4];
+    var length = bytes.readUInt16LE(pos + 5);
+    var value = bytes.slice(pos + 7, pos + 7 + length);
+
+    if (type === TUPLE_BYTE_ARRAY) {
+      data[key] = Array.prototype.slice.call(value);
+    } else if (type === TUPLE_CSTRING) {
+      data[key] = value.toString('utf8').replace(/\0[\s\S]*$/, '');
+    } else {
+      var signed = type !== TUPLE_UINT;
+      data[key] = length === 1 ? (signed ? value.readInt8(0) : value.readUInt8(0)) :
+                  length === 2 ? (signed ? value.readInt16LE(0) : value.readUInt16LE(0)) :
+                                 (signed ? value.readInt32LE(0) : value.readUInt32LE(0));
+    }
+    pos += 7 + length;
+  }
+  return data;
+};
+
+
+// watch_host in lock step through two FIFOs
+var Host = exports.Host = function(binary, start, persist) {
+  var args;
+
+  if (!fs.existsSync(binary)) {
+    throw new Error(binary + ' not found, build it with make -C test');
+  }
+
+  this.dir = fs.mkdtempSync(path.join(os.tmpdir(), 'pebble-term-'));
+  this.input = path.join(this.dir, 'in');
+  this.output = path.join(this.dir, 'out');
+  childProcess.execFileSync('mkfifo', [this.input, this.output]);
+
+  args = [this.input, this.output, '' + start].concat(persist ? ['-p', persist] : []);
+  this.child = childProcess.spawn(binary, args, { stdio: ['ignore', 'inherit', 'inherit'] });
+
+  // the host opens its input first
+  this.fdIn = fs.openSync(this.input, 'w');
+  this.fdOut = fs.openSync(this.output, 'r');
+  this.buffer = '';
+  this.chunk = Buffer.alloc(65536);
+};
+
+Host.prototype = {
+  line: function() {
+    var end;
+
+    while ((end = this.buffer.indexOf('\n')) === -1) {
+      var n = fs.readSync(this.fdOut, this.chunk, 0, this.chunk.length, null);
+
+      if (!n) {
+        throw new Error('watch_host exited');
+      }
+      this.buffer += this.chunk.toString('latin1', 0, n);
+    }
+
+    var line = this.buffer.slice(0, end);
+    this.buffer = this.buffer.slice(end + 1);
+    return line;
+  },
+  // Lines of one reply and the next deadline
+  reply: function() {
+    var lines = [];
+    var line;
+
+    while ((line = this.line()).slice(0, 2) !== '. ') {
+      lines.push(line);
+    }
+    return { lines: lines, next: +line.slice(2) };
+  },
+  command: function(line) {
+    fs.writeSync(this.fdIn, line + '\n');
+    return this.reply();
+  },
+  close: function() {
+    fs.closeSync(this.fdIn);
+    fs.closeSync(this.fdOut);
+    fs.rmSync(this.dir, { recursive: true, force: true });
+  }
+};
+
+
+var LinkWatch = exports.LinkWatch = function(options) {
+  options = options || {};
+
+  this.binary = options.binary || BINARY;
+  this.persist = options.persist || null;
+  this.latency = options.latency === void 0 ? 60 : options.latency;
+  this.bandwidth = options.bandwidth || 2000;
+  this.loss = options.loss || 0;
+  this.busy = options.busy || 0;
+  this.disconnects = options.disconnects || [];
+  this.seed = options.seed || 1;
+  this.verbose = !!options.verbose;
+  this.harness = null;
+  this.host = null;
+  this.hostTimer = null;
+  this.hostAt = -1;
+  this.air = 0;
+  this.connected = true;
+  this.headlines = [];
+  this.latencies = [];
+  this.logs = [];
+  this.dropped = 0;
+  this.watch = {};
+  this.counters = {
+    sent: 0,       // messages from the watch
+    received: 0,   // accepted by the watch
+    busy: 0,
+    wakeups: 0
+  };
+  this.link = {
+    toWatch: { messages: 0, bytes: 0, acked: 0, busy: 0, lost: 0, offline: 0 },
+    toPhone: { messages: 0, bytes: 0, acked: 0, busy: 0, lost: 0, offline: 0 }
+  };
+  // watch messages by msgType
+  this.types = {};
+};
+
+LinkWatch.prototype = {
+  attach: function(harness) {
+    var self = this;
+
+    this.harness = harness;
+    this.clock = harness.clock;
+    this.start = this.clock.now;
+    this.names = {};
+    Object.keys(harness.keys).forEach(function(name) {
+      self.names[harness.keys[name]] = name;
+    });
+
+    this.host = new Host(this.binary, this.start, this.persist);
+    this.handle(this.host.reply());
+
+    this.disconnects.forEach(function(window) {
+      self.clock.schedule(function() {
+        self.connected = false;
+        self.command('B', '0');
+      }, window[0], 'link');
+      self.clock.schedule(function() {
+        self.connected = true;
+        self.command('B', '1');
+      }, window[1], 'link');
+    });
+  },
+  random: function() {
+    this.seed = (this.seed * 1103515245 + 12345) & 0x7fffffff;
+    return this.seed / 0x80000000;
+  },
+  command: function(name, arg) {
+    var line = name + ' ' + this.clock.now + (arg === void 0 ? '' : ' ' + arg);
+
+    return this.handle(this.host.command(line));
+  },
+  // What the watch did during a command, and when it wants to run next
+  handle: function(reply) {
+    var self = this;
+
+    reply.lines.forEach(function(line) {
+      var kind = line.charAt(0);
+
+      if (kind === 'O') {
+        self.fromWatch(Buffer.from(line.slice(2), 'hex'));
+      } else if (kind === 'L') {
+        self.logs.push(line.slice(2));
+        if (self.verbose) {
+          console.log('[%s] watch: %s', new Date(self.clock.now).toISOString().slice(11, 23),
+                      line.slice(2));
+        }
+      } else if (kind === 'C') {
+        line.slice(2).split(' ').forEach(function(pair) {
+          var kv = pair.split('=');
+          self.watch[kv[0]] = +kv[1];
+        });
+      }
+    });
+
+    if (reply.next !== this.hostAt) {
+      if (this.hostTimer) {
+        this.clock.cancel(this.hostTimer);
+        this.hostTimer = null;
+      }
+      this.hostAt = reply.next;
+      if (reply.next !== -1) {
+        this.hostTimer = this.clock.schedule(function() {
+          self.hostTimer = null;
+          self.hostAt = -1;
+          self.command('T');
+        }, reply.next - this.clock.now, 'watch');
+      }
+    }
+    return reply.lines;
+  },
+  // The message waits for the air, then takes its time on it
+  transmit: function(size, arrive) {
+    var start = Math.max(this.clock.now, this.air);
+
+    this.air = start + Math.ceil(size * 1000 / this.bandwidth);
+    this.clock.schedule(arrive, this.air + this.latency - this.clock.now, 'link');
+  },
+  // Decides how a message fares: null if it gets through, else how long
+  // until the sender hears it failed
+  fate: function(stats) {
+    if (!this.connected) {
+      stats.offline++;
+      return NOT_CONNECTED;
+    }
+    if (this.random() < this.loss) {
+      stats.lost++;
+      return TIMEOUT;
+    }
+    return null;
+  },
+  // app_message_outbox_send on the watch
+  fromWatch: function(bytes) {
+    var self = this;
+    var stats = this.link.toPhone;
+    var fail = this.fate(stats);
+    var type = MSG_TYPE_NAMES[decode(bytes)[this.harness.keys.msgType]] || 'other';
+
+    this.types[type] = (this.types[type] || 0) + 1;
+    this.counters.sent++;
+    stats.messages++;
+    stats.bytes += bytes.length;
+
+    if (fail !== null) {
+      this.clock.schedule(function() {
+        self.command('X');
+      }, fail, 'link');
+      return;
+    }
+
+    this.transmit(bytes.length, function() {
+      var accepted = self.connected && self.random() >= self.busy;
+
+      if (!self.connected) {
+        stats.offline++;
+      } else if (!accepted) {
+        stats.busy++;
+      } else {
+        stats.acked++;
+        self.harness.appmessage(self.named(decode(bytes)));
+      }
+      self.clock.schedule(function() {
+        self.command(accepted ? 'A' : 'X');
+      }, self.latency, 'link');
+    });
+  },
+  named: function(data) {
+    var names = this.names;
+    var payload = {};
+
+    Object.keys(data).forEach(function(key) {
+      payload[names[key] || key] = data[key];
+    });
+    return payload;
+  },
+  // Pebble.sendAppMessage on the phone
+  receive: function(data, ack, nack) {
+    var self = this;
+    var stats = this.link.toWatch;
+    var bytes = encode(data);
+    var sent = this.clock.now;
+    var fail = this.fate(stats);
+
+    stats.messages++;
+    stats.bytes += bytes.length;
+
+    if (fail !== null) {
+      this.clock.schedule(function() {
+        nack(self.connected ? 'timeout' : 'not connected');
+      }, fail, 'link');
+      return;
+    }
+
+    this.transmit(bytes.length, function() {
+      var accepted = false;
+
+      if (!self.connected) {
+        stats.offline++;
+      } else if (self.random() < self.busy) {
+        stats.busy++;
+      } else {
+        accepted = self.command('I', bytes.toString('hex')).indexOf('a') !== -1;
+        if (accepted) {
+          stats.acked++;
+          self.counters.received++;
+          self.accepted(self.harness.decode(data), sent);
+        } else {
+          self.dropped++;
+        }
+      }
+
+      self.clock.schedule(function() {
+        if (accepted) {
+          ack();
+        } else {
+          nack(self.connected ? 'busy' : 'not connected');
+        }
+      }, self.latency, 'link');
+    });
+  },
+  accepted: function(msg, sent) {
+    if (msg.msgType !== MSG_TYPE_FEED_TITLE) {
+      return;
+    }
+
+    var title = msg.feedPacked ? unpack(msg.feedPacked) : msg.feedTitle;
+
+    if (title) {
+      this.headlines.push({ time: this.clock.now, title: title });
+      this.latencies.push(this.clock.now - sent);
+    }
+  },
+  screenshot: function(file) {
+    this.command('Q', path.resolve(file));
+  },
+  // Counters of the watch, then exit
+  finish: function() {
+    if (!this.host) {
+      return this.watch;
+    }
+    this.command('C');
+    this.counters.wakeups = this.watch.wakeups;
+    this.counters.busy = this.watch.outbox_busy;
+    this.handle(this.host.command('E ' + this.clock.now));
+    this.host.close();
+    this.host = null;
+    return this.watch;
+  }
+};
+
+
+var percentile = function(values, p) {
+  var sorted = values.slice().sort(function(a, b) {
+    return a - b;
+  });
+
+  return sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))] : 0;
+};
+
+var format = exports.format = function(r) {
+  var side = function(s) {
+    return s.messages + ' messages, ' + s.bytes + ' bytes, ' + s.acked + ' acked (' +
+           s.busy + ' busy, ' + s.lost + ' lost, ' + s.offline + ' offline)';
+  };
+  var w = r.watch;
+  var lines = [
+    ['link', r.latency + ' ms, ' + r.bandwidth + ' B/s, loss ' + r.loss + ', busy ' + r.busy +
+             (r.disconnects.length ? ', down ' + r.disconnects.map(function(d) {
+               return d[0] / 1000 + '-' + d[1] / 1000 + ' s';
+             }).join(' ') : '')],
+    ['phone to watch', side(r.toWatch)],
+    ['watch to phone', side(r.toPhone)],
+    ['watch sends', Object.keys(r.types).sort().map(function(type) {
+      return r.types[type] + ' ' + type;
+    }).join(', ') || 'nothing'],
+    ['headline send', r.latencies.length + ' accepted, ' + r.latencyMean.toFixed(0) +
+                      ' ms mean, ' + r.latencyP90 + ' ms p90, ' + r.latencyMax + ' ms max'],
+    ['retransmits', r.retransmits + ' (' + r.superseded + ' older headlines superseded)'],
+    ['watch', w.wakeups + ' wakeups, ' + w.frames + ' frames, ' + w.glyphs + ' glyphs, ' +
+              w.outbox_busy + ' outbox busy, ' + w.outbox_failed + ' failed'],
+    ['watch cpu', (w.app_ns / 1e6).toFixed(1) + ' ms app, ' + (w.render_ns / 1e6).toFixed(1) +
+                  ' ms render (host)'],
+    ['first frame', w.first_frame_ms + ' ms after launch']
+  ];
+
+  return lines.map(function(line) {
+    return (line[0] + ':' + new Array(16).join(' ')).slice(0, 16) + line[1];
+  }).join('\n');
+};
+
+var simulate = exports.simulate = function(options) {
+  var watch = new LinkWatch(options);
+  var result = hour.simulate({
+    minutes: options.minutes,
+    pull: options.pull,
+    features: options.features,
+    server: new FeedServer({ compact: options.compact }),
+    watch: watch,
+    verbose: options.verbose
+  });
+
+  if (options.screenshot) {
+    watch.screenshot(options.screenshot);
+  }
+
+  var counters = watch.finish();
+
+  // the model's numbers, from the real watch
+  result.watchWakeups = counters.wakeups;
+  result.watchBusy = counters.outbox_busy;
+  result.link = {
+    latency: watch.latency,
+    bandwidth: watch.bandwidth,
+    loss: watch.loss,
+    busy: watch.busy,
+    disconnects: watch.disconnects,
+    toWatch: watch.link.toWatch,
+    toPhone: watch.link.toPhone,
+    types: watch.types,
+    latencies: watch.latencies,
+    latencyMean: watch.latencies.reduce(function(a, b) {
+      return a + b;
+    }, 0) / (watch.latencies.length || 1),
+    latencyP90: percentile(watch.latencies, 0.9),
+    latencyMax: percentile(watch.latencies, 1),
+    retransmits: result.harness.stats().retransmits,
+    superseded: result.harness.stats().superseded,
+    dropped: watch.dropped,
+    watch: counters
+  };
+  return result;
+};
+
+if (require.main === module) {
+  var args = process.argv.slice(2);
+  var arg = function(name, def) {
+    var i = args.indexOf(name);
+    return i !== -1 ? args[i + 1] : def;
+  };
+  var disconnects = [];
+  var features = arg('--features');
+
+  features = features === void 0 ? void 0 : features.split(',').filter(Boolean);
+
+  args.forEach(function(value, i) {
+    if (value === '--disconnect') {
+      disconnects.push(args[i + 1].split(':').map(function(s) {
+        return s * 1000;
+      }));
+    }
+  });
+
+  var result = simulate({
+    binary: arg('--watch', BINARY),
+    minutes: +arg('--minutes', 60),
+    pull: args.indexOf('--pull') !== -1,
+    compact: args.indexOf('--compact') !== -1,
+    latency: +arg('--latency', 60),
+    bandwidth: +arg('--bandwidth', 2000),
+    loss: +arg('--loss', 0),
+    busy: +arg('--busy', 0),
+    seed: +arg('--seed', 1),
+    disconnects: disconnects,
+    features: features,
+    screenshot: arg('--screenshot'),
+    verbose: args.indexOf('--verbose') !== -1
+  });
+
+  if (args.indexOf('--json') !== -1) {
+    delete result.harness;
+    console.log(JSON.stringify(result, null, 2));
+  } else {
+    console.log(hour.format(result));
+    console.log(format(result.link));
+  }
+
+  result.errors.forEach(function(error) {
+    console.error(error);
+  });
+  var feed = !features || features.indexOf('feed') !== -1;
+
+  if (result.errors.length || result.link.dropped || (feed && !result.headlines)) {
+    console.error(result.errors.length ? 'link: script threw' :
+                  result.link.dropped ? 'link: the watch dropped ' + result.link.dropped + ' messages' :
+                  'link: no headline reached the watch');
+    process.exit(1);
+  }
+}
@@ -0,0 +1,123 @@
+/*
+ * Pebble Term Watch
+ *
+ * Render cost of skipping text_layer_set_text calls that would not change
+ * the text: the same simulated hour on the watch_host built as shipped
+ * (build/<profile>) and one that re-sets every time (make -C test
+ * SKIP_SAME_TEXT=0, build/<profile>-resets).
+ *
+ * Only the set calls and dirty marks differ. Every frame still draws
+ * every layer, so frames and glyphs match; the static prompt is not
+ * drawn once and kept.
+ *
+ * Usage: node test/js/render.js [--minutes N] [--runs N] [--features LIST]
+ *          [--watch PATH] [--baseline PATH] [--json]
+ *
+ * Frames, text sets and dirty marks come from the stand-in SDK and carry
+ * over to the watch; render time is the host's CPU (median of the runs),
+ * so only the ratio does.
+ * Exits non-zero if either run fails as link.js would.
+ */
+
+'use strict';
+
+var path = require('path');
+
+var link = require('./link');
+
+var BUILD = path.join(__dirname, '..', 'build');
+
+var args = process.argv.slice(2);
+var arg = function(name, def) {
+  var i = args.indexOf(name);
+  return i !== -1 ? args[i + 1] : def;
+};
+
+var features = arg('--features');
+features = features === void 0 ? void 0 : features.split(',').filter(Boolean);
+
+var median = function(values) {
+  var sorted = values.slice().sort(function(a, b) {
+    return a - b;
+  });
+
+  return sorted[sorted.length >> 1];
+};
+
+var once = function(binary) {
+  var result = link.simulate({
+    binary: binary,
+    minutes: +arg('--minutes', 60),
+    latency: 60,
+    bandwidth: 2000,
+    loss: 0,
+    busy: 0,
+    seed: 1,
+    disconnects: [],
+    features: features
+  });
+  var w = result.link.watch;
+
+  return {
+    errors: result.errors.concat(result.link.dropped ? [binary + ': dropped messages'] : []),
+    frames: w.frames,
+    glyphs: w.glyphs,
+    textSets: w.text_sets,
+    dirty: w.dirty,
+    renderNs: w.render_ns
+  };
+};
+
+// the simulation is seeded, only the host time differs between runs
+var run = function(binary) {
+  var results = [];
+
+  for (var i = +arg('--runs', 3); i > 0; i--) {
+    results.push(once(binary));
+  }
+
+  var r = results[0];
+  var renderNs = median(results.map(function(each) {
+    return each.renderNs;
+  }));
+
+  return {
+    errors: r.errors,
+    frames: r.frames,
+    glyphs: r.glyphs,
+    textSets: r.textSets,
+    dirty: r.dirty,
+    renderMs: renderNs / 1e6,
+    frameUs: r.frames ? renderNs / r.frames / 1e3 : 0
+  };
+};
+
+var report = {
+  skip: run(arg('--watch', path.join(BUILD, 'full', 'watch_host'))),
+  resets: run(arg('--baseline', path.join(BUILD, 'full-resets', 'watch_host')))
+};
+
+if (args.indexOf('--json') !== -1) {
+  console.log(JSON.stringify(report, null, 2));
+} else {
+  console.log('same text    frames   glyphs  text sets    dirty   render    per frame');
+  Object.keys(report).forEach(function(name) {
+    var r = report[name];
+
+    console.log((name + '          ').slice(0, 10) +
+                ('' + r.frames).padStart(9) + ('' + r.glyphs).padStart(9) +
+                ('' + r.textSets).padStart(11) + ('' + r.dirty).padStart(9) +
+                (r.renderMs.toFixed(1) + ' ms').padStart(10) +
+                (r.frameUs.toFixed(1) + ' us').padStart(13));
+  });
+  console.log('render time skipping same text: ' +
+              (100 * report.skip.renderMs / (report.resets.renderMs || 1)).toFixed(0) +
+              '% of re-setting it (host)');
+}
+
+var errors = report.skip.errors.concat(report.resets.errors);
+
+errors.forEach(function(error) {
+  console.error('render: ' + error);
+});
+process.exit(errors.length ? 1 : 0);
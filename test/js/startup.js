@@ -0,0 +1,130 @@
+/*
+ * Pebble Term Watch
+ *
+ * Launch to first frame and launch to ready (the feed open with sync, the
+ * status bar without) for each profile built by test/Makefile, from the
+ * "startup:" line the watchface logs and the host's CPU counters.
+ *
+ * Usage: node test/js/startup.js [--runs N] [--profile NAME] [--json]
+ *
+ * Virtual times are the watch's own stage timestamps; CPU is the host's,
+ * so only the ratios between stages and profiles carry over to the watch.
+ * Exits non-zero if a profile never logs its startup line.
+ */
+
+'use strict';
+
+var fs = require('fs');
+var path = require('path');
+
+var link = require('./link');
+
+var ROOT = path.join(__dirname, '..', '..');
+var BUILD = path.join(ROOT, 'test', 'build');
+var PROFILES = ['minimal', 'status', 'full'];
+var START = Date.UTC(2026, 0, 1, 12, 0, 0);
+// the stages are 50 ms apart, a launch is over well within this
+var LIMIT = 5000;
+
+var args = process.argv.slice(2);
+var arg = function(name, def) {
+  var i = args.indexOf(name);
+  return i !== -1 ? args[i + 1] : def;
+};
+
+var median = function(values) {
+  var sorted = values.slice().sort(function(a, b) {
+    return a - b;
+  });
+
+  return sorted.length ? sorted[sorted.length >> 1] : 0;
+};
+
+var counters = function(line) {
+  var result = {};
+
+  line.slice(2).split(' ').forEach(function(pair) {
+    var kv = pair.split('=');
+    result[kv[0]] = +kv[1];
+  });
+  return result;
+};
+
+// One launch, stepping from deadline to deadline until the watch is ready
+var launch = function(binary) {
+  var host = new link.Host(binary, START);
+  var reply = host.reply();
+  var now = START;
+  var m = null;
+
+  for (;;) {
+    reply.lines.forEach(function(line) {
+      m = m || /startup: first frame (\d+) ms, ready (\d+) ms/.exec(line);
+    });
+    if (m || reply.next === -1 || reply.next - START > LIMIT) {
+      break;
+    }
+    now = reply.next;
+    reply = host.command('T ' + now);
+  }
+
+  var c = counters(host.command('C ' + now).lines[0]);
+
+  host.command('E ' + now);
+  host.close();
+
+  return m && {
+    firstFrameMs: +m[1],
+    readyMs: +m[2],
+    firstFrameUs: c.first_frame_ns / 1000,
+    readyUs: c.log_ns / 1000,
+    frames: c.frames
+  };
+};
+
+var runs = +arg('--runs', 20);
+var only = arg('--profile', null);
+var failures = [];
+var report = {};
+
+PROFILES.filter(function(name) {
+  return (!only || name === only) && fs.existsSync(path.join(BUILD, name, 'watch_host'));
+}).forEach(function(name) {
+  var results = [];
+
+  for (var i = 0; i < runs; i++) {
+    var r = launch(path.join(BUILD, name, 'watch_host'));
+
+    if (!r) {
+      failures.push(name + ': no startup line within ' + LIMIT + ' ms');
+      return;
+    }
+    results.push(r);
+  }
+
+  report[name] = {};
+  Object.keys(results[0]).forEach(function(key) {
+    report[name][key] = median(results.map(function(r) {
+      return r[key];
+    }));
+  });
+});
+
+if (args.indexOf('--json') !== -1) {
+  console.log(JSON.stringify(report, null, 2));
+} else {
+  console.log('profile   first frame        ready        frames   (median of ' + runs + ')');
+  Object.keys(report).forEach(function(name) {
+    var r = report[name];
+
+    console.log((name + '          ').slice(0, 10) +
+                (r.firstFrameMs + ' ms ').padStart(8) + (r.firstFrameUs.toFixed(0) + ' us').padStart(10) +
+                (r.readyMs + ' ms ').padStart(9) + (r.readyUs.toFixed(0) + ' us').padStart(10) +
+                ('' + r.frames).padStart(7));
+  });
+}
+
+failures.forEach(function(f) {
+  console.error('startup: ' + f);
+});
+process.exit(failures.length ? 1 : 0);
@@ -0,0 +1,526 @@
+/*
+ * Pebble Term Watch
+ *
+ * Watch event traces (term_trace.c) on Linux: decodes a dump, replays it
+ * through the watchface (watch_host) and checks the dump itself.
+ *
+ *   node test/js/trace.js decode FILE    phone log ("trace: ..." lines)
+ *                                        or chunks as hex, one per line
+ *   node test/js/trace.js replay FILE    feeds the recorded battery,
+ *                                        bluetooth and message events to
+ *                                        the watch at their times, dumps
+ *                                        its trace and compares the two
+ *   node test/js/trace.js check          a dump the phone never answers and
+ *                                        one cut by a disconnect both give
+ *                                        the ring back; a settled watch
+ *                                        replayed from its dump ends with
+ *                                        the same events, counters and
+ *                                        screen
+ *
+ * Options: --watch PATH (watch_host), --verbose
+ *
+ * Message values are not in the trace: replayed tuples carry zeros, or
+ * x's of the recorded length for strings. Neither is the launch once the
+ * ring has wrapped; replay takes it from the caller when it is known.
+ */
+
+'use strict';
+
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+var Harness = require('./harness').Harness;
+var link = require('./link');
+
+var ROOT = path.join(__dirname, '..', '..');
+var BINARY = path.join(ROOT, 'test', 'build', 'full', 'watch_host');
+// watch tick times are whole seconds from here
+var BASE = Date.UTC(2026, 0, 1, 12, 0, 0);
+var LATENCY = 60;
+// AppMessage gives up on an unanswered message after this long
+var TIMEOUT = 3000;
+// the startup stages are over by then
+var STARTUP = 1000;
+
+var MSG_TYPE_PING = 0;
+var MSG_TYPE_TRACE_DUMP = 3;
+
+var modules = new Harness().load().modules;
+var Trace = modules.Trace;
+var schema = JSON.parse(fs.readFileSync(path.join(ROOT, 'message_keys.json'), 'utf8'));
+var KEYS = {};
+
+schema.keys.forEach(function(key) {
+  KEYS[key.key] = key;
+});
+
+
+// Trace records from Trace.decode lines or raw record bytes
+var parseLines = exports.parseLines = function(lines) {
+  return lines.map(function(line) {
+    var m = /^\+(\d+)ms (\S+) (\d+) (\S+)$/.exec(line.replace(/^.*?trace: /, ''));
+
+    if (!m) {
+      return null;
+    }
+
+    var len = Trace.RESULTS.indexOf(m[4]);
+
+    return {
+      time: +m[1],
+      type: m[2],
+      arg: +m[3],
+      // sends carry the result code, 0 for APP_MSG_OK
+      len: m[2] === 'send' && len !== -1 ? (len && len + 1) : +m[4]
+    };
+  }).filter(Boolean);
+};
+
+var decodeBytes = exports.decodeBytes = function(bytes) {
+  return parseLines(Trace.decode(bytes));
+};
+
+var read = function(file) {
+  var lines = fs.readFileSync(file, 'utf8').split('\n').filter(function(line) {
+    return line.trim();
+  });
+
+  if (lines.some(function(line) {
+    return /trace: /.test(line);
+  })) {
+    return parseLines(lines);
+  }
+
+  // chunks, the 2 byte chunk header first
+  return decodeBytes([].concat.apply([], lines.map(function(line) {
+    return Array.prototype.slice.call(Buffer.from(line.trim(), 'hex'), 2);
+  })));
+};
+
+var format = function(r) {
+  return '+' + r.time + 'ms ' + r.type + ' ' + r.arg + ' ' + r.len;
+};
+
+
+// watch_host with a phone that acks after LATENCY, or lets every message
+// time out
+var Session = exports.Session = function(binary, start) {
+  this.now = start;
+  this.start = start;
+  this.next = -1;
+  this.answer = 'ack';
+  this.inflight = null;
+  this.received = [];
+  this.chunks = [];
+  this.dumps = [];
+  this.host = new link.Host(binary, start);
+  this.handle(this.host.reply());
+};
+
+Session.prototype = {
+  handle: function(reply) {
+    var self = this;
+
+    reply.lines.forEach(function(line) {
+      if (line.charAt(0) !== 'O') {
+        return;
+      }
+
+      var data = link.decode(Buffer.from(line.slice(2), 'hex'));
+
+      self.received.push({ time: self.now, data: data });
+      self.inflight = {
+        at: self.now + (self.answer === 'ack' ? 2 * LATENCY : TIMEOUT),
+        ack: self.answer === 'ack',
+        data: data
+      };
+    });
+    this.next = reply.next;
+  },
+  command: function(name, t, arg) {
+    this.now = t;
+    this.handle(this.host.command(name + ' ' + t + (arg === void 0 ? '' : ' ' + arg)));
+  },
+  // the phone gets the message once it is acked
+  settle: function() {
+    var message = this.inflight;
+
+    this.inflight = null;
+    this.command(message.ack ? 'A' : 'X', message.at);
+
+    var chunk = message.ack && message.data[9];
+
+    if (chunk) {
+      this.chunks[chunk[0]] = chunk.slice(2);
+      if (chunk[0] === chunk[1] - 1) {
+        this.dumps.push(decodeBytes([].concat.apply([], this.chunks)));
+        this.chunks = [];
+      }
+    }
+  },
+  run: function(t) {
+    for (;;) {
+      var due = this.inflight ? this.inflight.at : Infinity;
+
+      if (due <= t && (this.next === -1 || due <= this.next)) {
+        this.settle();
+      } else if (this.next !== -1 && this.next <= t) {
+        this.command('T', this.next);
+      } else {
+        break;
+      }
+    }
+    if (t > this.now) {
+      this.command('T', t);
+    }
+  },
+  send: function(t, data) {
+    this.run(t);
+    this.command('I', t, link.encode(data).toString('hex'));
+  },
+  // Counters (host CPU left out), visible text and pixels right now
+  snapshot: function() {
+    var file = path.join(os.tmpdir(), 'trace-' + process.pid + '.pbm');
+    var lines = this.host.command('C ' + this.now).lines
+      .concat(this.host.command('S ' + this.now).lines);
+    var state = { counters: {}, screen: [] };
+
+    lines.forEach(function(line) {
+      if (line.charAt(0) === 'C') {
+        line.slice(2).split(' ').forEach(function(pair) {
+          var kv = pair.split('=');
+
+          if (!/_ns$/.test(kv[0])) {
+            state.counters[kv[0]] = +kv[1];
+          }
+        });
+      } else if (line.charAt(0) === 'S') {
+        state.screen.push(line.slice(2));
+      }
+    });
+
+    this.host.command('Q ' + this.now + ' ' + file);
+    state.pixels = fs.readFileSync(file);
+    fs.unlinkSync(file);
+    return state;
+  },
+  dump: function(t) {
+    var count = this.dumps.length;
+
+    this.send(t, { 5: MSG_TYPE_TRACE_DUMP });
+    return count;
+  },
+  close: function() {
+    this.command('E', this.now);
+    this.host.close();
+  }
+};
+
+
+// Tuples that arrived together, as one message with placeholder values
+var message = function(records) {
+  var data = {};
+
+  records.forEach(function(r) {
+    var key = KEYS[r.arg];
+
+    if (!key) {
+      return;
+    }
+    data[r.arg] = key.type === 'cstring' ? new Array(Math.max(r.len, 1)).join('x') :
+                  key.type === 'bytes' ? new Array(r.len + 1).join('0').split('').map(Number) :
+                  key.name === 'msgType' ? MSG_TYPE_PING : 0;
+  });
+  return data;
+};
+
+// The dump replayed, and the watch's state as it took the dump request.
+// launch: ms from the first record to the launch (<= 0), if known
+var replay = exports.replay = function(records, binary, launch) {
+  var tick = records.filter(function(r) {
+    return r.type === 'tick';
+  })[0];
+  // the first tick lands on a second with its tm_sec
+  var start = BASE + (tick ? tick.arg * 1000 - tick.time + 60000 : 0);
+  var session = new Session(binary, start + (launch || 0));
+  // a dump that still holds the launch: AppSync reports its initial values
+  // once the feed stage opens it, that first group is not a message
+  var t0 = records.length ? records[0].time : 0;
+  var first = records.filter(function(r) {
+    return r.type === 'tuple';
+  })[0];
+  var launched = records.some(function(r) {
+    return r.type === 'reset' && r.time === t0;
+  });
+  var launch = launched && first && first.time - t0 <= STARTUP ? first.time : -1;
+  var i = 0;
+
+  while (i < records.length) {
+    var r = records[i];
+    var t = start + r.time;
+
+    if (launched && r.time === t0 && r.type === 'battery') {
+      // init records the battery it starts with
+    } else if (r.type === 'battery') {
+      session.run(t);
+      session.command('P', t, r.arg + ' ' + r.len);
+    } else if (r.type === 'bluetooth') {
+      session.run(t);
+      session.command('B', t, '' + r.arg);
+    } else if (r.type === 'tuple' && r.time !== launch) {
+      var group = [];
+
+      while (i < records.length && records[i].type === 'tuple' && records[i].time === r.time) {
+        group.push(records[i++]);
+      }
+      // the last message is the dump request, the replay sends its own
+      if (i < records.length) {
+        session.send(t, message(group));
+      }
+      continue;
+    }
+    i++;
+  }
+
+  // where the original took its dump request
+  var end = start + (records.length ? records[records.length - 1].time : 0);
+
+  session.run(end);
+
+  var state = session.snapshot();
+  var count = session.dump(end);
+
+  session.answer = 'ack';
+  session.run(end + 10000);
+  session.close();
+
+  return { records: session.dumps[count] || [], state: state };
+};
+
+// Events by type, the external ones that moved or went missing and every
+// event that differs, from the first tick on both sides
+var compare = exports.compare = function(original, replayed) {
+  var types = {};
+  var offset = function(records) {
+    var first = records.filter(function(r) {
+      return r.type === 'tick';
+    })[0];
+    return first ? first.time : 0;
+  };
+  var a0 = offset(original), b0 = offset(replayed);
+  var external = function(records, t0) {
+    return records.filter(function(r) {
+      return r.type === 'battery' || r.type === 'bluetooth';
+    }).map(function(r) {
+      return (r.time - t0) + ' ' + r.type + ' ' + r.arg;
+    });
+  };
+
+  original.forEach(function(r) {
+    (types[r.type] = types[r.type] || [0, 0])[0]++;
+  });
+  replayed.forEach(function(r) {
+    (types[r.type] = types[r.type] || [0, 0])[1]++;
+  });
+
+  var expected = external(original, a0);
+  var actual = external(replayed, b0);
+  var events = function(records, t0) {
+    return records.map(function(r) {
+      return format(Object.assign({}, r, { time: r.time - t0 }));
+    });
+  };
+  var a = events(original, a0);
+  var b = events(replayed, b0);
+  var differ = [];
+
+  for (var i = 0; i < Math.max(a.length, b.length); i++) {
+    if (a[i] !== b[i]) {
+      differ.push((a[i] || '(none)') + ' / ' + (b[i] || '(none)'));
+    }
+  }
+
+  return {
+    types: types,
+    missing: expected.filter(function(e) {
+      return actual.indexOf(e) === -1;
+    }),
+    differ: differ
+  };
+};
+
+// What differs between two snapshots
+var compareState = exports.compareState = function(original, replayed) {
+  var differ = [];
+
+  Object.keys(original.counters).forEach(function(key) {
+    if (original.counters[key] !== replayed.counters[key]) {
+      differ.push(key + ' ' + original.counters[key] + ' / ' + replayed.counters[key]);
+    }
+  });
+  if (original.screen.join('\n') !== replayed.screen.join('\n')) {
+    differ.push('screen "' + original.screen.join(' | ') + '" / "' +
+                replayed.screen.join(' | ') + '"');
+  }
+  if (!original.pixels.equals(replayed.pixels)) {
+    differ.push('screen pixels');
+  }
+  return differ;
+};
+
+var report = function(result) {
+  console.log('event        original   replay');
+  Object.keys(result.types).forEach(function(type) {
+    console.log((type + '            ').slice(0, 12) +
+                ('' + result.types[type][0]).padStart(9) +
+                ('' + result.types[type][1]).padStart(9));
+  });
+  result.missing.forEach(function(e) {
+    console.log('not replayed: ' + e);
+  });
+  if (result.differ.length) {
+    console.log(result.differ.length + ' events differ, first: ' + result.differ[0]);
+  }
+};
+
+
+// A dump nobody answers and one cut by a disconnect must not keep the
+// ring paused
+var check = function(binary, verbose) {
+  var failures = [];
+  var s = new Session(binary, BASE + 30000);
+  var has = function(dump, type, arg) {
+    return dump && dump.some(function(r) {
+      return r.type === type && r.arg === arg;
+    });
+  };
+  var t = function(sec) {
+    return s.start + sec * 1000;
+  };
+
+  s.send(t(5), { 5: MSG_TYPE_PING });
+  s.run(t(8));
+  s.command('P', t(8), '70 0');
+
+  // the phone stops answering: the dump gives up within a few seconds
+  s.answer = 'timeout';
+  s.dump(t(20));
+  s.run(t(23.5));
+  s.command('P', t(23.5), '61 0');
+  s.run(t(28));
+  s.answer = 'ack';
+  var first = s.dump(t(30));
+  s.run(t(35));
+
+  if (!has(s.dumps[first], 'battery', 61)) {
+    failures.push('recording did not resume after an unanswered dump');
+  }
+
+  // a disconnect ends the dump at once
+  s.answer = 'timeout';
+  s.dump(t(40));
+  s.run(t(40.3));
+  s.command('B', t(40.3), '0');
+  s.run(t(42));
+  s.command('B', t(42), '1');
+  s.run(t(44));
+  s.answer = 'ack';
+  var second = s.dump(t(45));
+  s.run(t(50));
+  s.close();
+
+  var dump = s.dumps[second];
+
+  if (!has(dump, 'bluetooth', 0) || !has(dump, 'bluetooth', 1)) {
+    failures.push('recording did not resume after a disconnect');
+  }
+
+  // A settled watch, every outside event after the launch fell off the ring
+  var o = new Session(binary, BASE + 30000);
+  var at = function(sec) {
+    return o.start + sec * 1000;
+  };
+
+  o.send(at(45), { 5: MSG_TYPE_PING });
+  o.run(at(50));
+  o.command('P', at(50), '70 0');
+  o.run(at(70));
+  o.command('B', at(70), '0');
+  o.run(at(72));
+  o.command('B', at(72), '1');
+  o.send(at(80), { 5: MSG_TYPE_PING });
+  o.run(at(95));
+  o.command('P', at(95), '65 1');
+  o.run(at(100));
+
+  var state = o.snapshot();
+  var third = o.dump(at(100));
+
+  o.run(at(110));
+  o.close();
+
+  var records = o.dumps[third];
+
+  if (!records || !records.length) {
+    failures.push('no dump to replay');
+  } else {
+    if (verbose) {
+      records.forEach(function(r) {
+        console.log('trace: ' + format(r));
+      });
+    }
+
+    // the dump request is the last record
+    var replayed = replay(records, binary, o.start - (at(100) - records[records.length - 1].time));
+    var result = compare(records, replayed.records);
+    var differ = compareState(state, replayed.state);
+
+    report(result);
+    if (result.missing.length) {
+      failures.push('replay lost ' + result.missing.length + ' events');
+    }
+    if (result.differ.length) {
+      failures.push('replay differs in ' + result.differ.length + ' events, first: ' +
+                    result.differ[0]);
+    }
+    differ.forEach(function(d) {
+      failures.push('replay ends differently: ' + d);
+    });
+  }
+
+  failures.forEach(function(f) {
+    console.error('trace: ' + f);
+  });
+  return failures.length === 0;
+};
+
+if (require.main === module) {
+  var args = process.argv.slice(2);
+  var watch = args.indexOf('--watch');
+  var binary = watch !== -1 ? args[watch + 1] : BINARY;
+  var verbose = args.indexOf('--verbose') !== -1;
+  var ok = true;
+
+  if (args[0] === 'decode') {
+    read(args[1]).forEach(function(r) {
+      console.log(format(r));
+    });
+  } else if (args[0] === 'replay') {
+    var dumped = read(args[1]);
+    var replayed = replay(dumped, binary).records;
+
+    if (verbose) {
+      replayed.forEach(function(r) {
+        console.log('replay: ' + format(r));
+      });
+    }
+    report(compare(dumped, replayed));
+  } else if (args[0] === 'check') {
+    ok = check(binary, verbose);
+  } else {
+    console.error('usage: trace.js decode|replay FILE | check [--watch PATH] [--verbose]');
+    ok = false;
+  }
+  process.exit(ok ? 0 : 1);
+}
@@ -0,0 +1,230 @@
+/*
+ * Pebble Term Watch
+ *
+ * Message level model of the watchface for the harness: what it sends,
+ * when, and what it does with a headline. The timings follow
+ * pebble_term_watch.c (ping every MESSAGE_STATE_SEND + 1 frames of
+ * PROMPT_DELTA, FEED_READY once the feed is enabled, FEED_NEXT at the end
+ * of each scroll loop in pull mode); link.js runs the real watchface
+ * instead.
+ *
+ *   new ScriptedWatch({ latency: 60, disconnects: [[from, to], ...] })
+ */
+
+'use strict';
+
+var fs = require('fs');
+var path = require('path');
+
+var PROMPT_DELTA = 1000;
+var MARQUEE_DELTA = 500;
+var PING_PERIOD = 6 * PROMPT_DELTA;
+var FEED_WAIT_TIME_LIMIT = 5;
+var FEED_TITLE_CHUNK_SIZE = 17;
+var FEED_SEEN_HASH_LEN = 96;
+var FEED_CACHE_PREFIX = 'cache: ';
+// typing animation until the first ping
+var STARTUP = 33 * 200;
+
+// FEED_CODEC_DICT, from the decoder itself
+var DICT = (function() {
+  var source = fs.readFileSync(path.join(__dirname, '..', '..', 'src', 'feed_codec.c'), 'utf8');
+  var body = /FEED_CODEC_DICT\[[^\]]*\] = \{([\s\S]*?)\};/.exec(source)[1];
+
+  return body.match(/"(?:[^"\\]|\\.)*"/g).map(function(word) {
+    return JSON.parse(word);
+  });
+}());
+
+// feed_unpack
+var unpack = exports.unpack = function(bytes) {
+  var s = '';
+  var bits = 0, nbits = 0, symbol;
+
+  for (var i = 0; i < bytes.length; i++) {
+    bits = ((bits << 8) | bytes[i]) & 0xffff;
+    nbits += 8;
+
+    while (nbits >= 7) {
+      nbits -= 7;
+      symbol = (bits >> nbits) & 0x7f;
+
+      if (symbol === 0) {
+        return s;
+      }
+      s += symbol < 0x20 ? DICT[symbol - 1] :
+           symbol === 0x7f ? DICT[DICT.length - 1] : String.fromCharCode(symbol);
+    }
+  }
+  return s;
+};
+
+// feed_title_hash
+var hash = exports.hash = function(title) {
+  var h = 2166136261;
+
+  if (title.indexOf(FEED_CACHE_PREFIX) === 0) {
+    title = title.slice(FEED_CACHE_PREFIX.length);
+  }
+  for (var i = 0; i < title.length && i < FEED_SEEN_HASH_LEN; i++) {
+    h = Math.imul(h ^ (title.charCodeAt(i) & 0xff), 16777619) >>> 0;
+  }
+  return h;
+};
+
+var ScriptedWatch = exports.ScriptedWatch = function(options) {
+  options = options || {};
+
+  // one way, phone to watch and back
+  this.latency = options.latency === void 0 ? 60 : options.latency;
+  this.disconnects = options.disconnects || [];
+  this.harness = null;
+  this.settings = {};
+  this.feedHash = 0;
+  this.loopTimer = null;
+  this.busy = false;
+  this.headlines = [];
+  this.counters = {
+    received: 0,   // messages from the phone
+    sent: 0,       // to the phone
+    busy: 0,       // not sent, the outbox was busy
+    lost: 0,       // either way while disconnected
+    pings: 0,
+    next: 0,       // FEED_NEXT
+    wakeups: 0     // distinct ms the watch woke up for the link
+  };
+  this.lastWake = -1;
+};
+
+ScriptedWatch.prototype = {
+  attach: function(harness) {
+    var self = this;
+
+    this.harness = harness;
+    this.clock = harness.clock;
+    this.start = this.clock.now;
+
+    this.clock.schedule(function ping() {
+      self.ping();
+      self.clock.schedule(ping, PING_PERIOD, 'watch');
+    }, STARTUP, 'watch');
+  },
+  connected: function() {
+    var t = this.clock.now - this.start;
+
+    return !this.disconnects.some(function(window) {
+      return t >= window[0] && t < window[1];
+    });
+  },
+  wake: function() {
+    if (this.lastWake !== this.clock.now) {
+      this.lastWake = this.clock.now;
+      this.counters.wakeups++;
+    }
+  },
+  nextWake: function() {
+    return 60 - new Date(this.clock.now).getUTCSeconds();
+  },
+  // app_message_outbox_send, one message in flight
+  send: function(payload) {
+    var self = this;
+    var harness = this.harness;
+
+    if (this.busy) {
+      this.counters.busy++;
+      return false;
+    }
+
+    this.counters.sent++;
+    if (!this.connected()) {
+      this.counters.lost++;
+      return true;
+    }
+
+    this.busy = true;
+    this.clock.schedule(function() {
+      harness.appmessage(payload);
+      self.clock.schedule(function() {
+        self.busy = false;
+      }, self.latency, 'watch');
+    }, this.latency, 'watch');
+    return true;
+  },
+  ping: function() {
+    this.wake();
+    this.counters.pings++;
+    this.send({ msgType: 0, nextWake: this.nextWake() });
+  },
+  ready: function() {
+    this.send({ msgType: 1, feedHash: this.feedHash, nextWake: this.nextWake() });
+  },
+  // sendAppMessage from the phone
+  receive: function(data, ack, nack) {
+    var self = this;
+
+    if (!this.connected()) {
+      this.counters.lost++;
+      this.clock.schedule(function() {
+        nack('timeout');
+      }, 2 * this.latency + 1000, 'watch');
+      return;
+    }
+
+    this.clock.schedule(function() {
+      self.wake();
+      self.counters.received++;
+      self.sync(self.harness.decode(data));
+      self.clock.schedule(ack, self.latency, 'watch');
+    }, this.latency, 'watch');
+  },
+  // sync_tuple_changed_callback
+  sync: function(msg) {
+    var settings = this.settings;
+    var enabled = settings.feedEnabled;
+
+    Object.keys(msg).forEach(function(name) {
+      settings[name] = msg[name];
+    });
+
+    if (msg.feedEnabled && !enabled) {
+      this.ready();
+    }
+
+    if (msg.msgType !== 2) {
+      return;
+    }
+
+    var title = msg.feedPacked ? unpack(msg.feedPacked) : msg.feedTitle;
+
+    if (title) {
+      this.show(title);
+    }
+  },
+  show: function(title) {
+    var self = this;
+    var length = Math.max(title.length, FEED_TITLE_CHUNK_SIZE) + 13;
+
+    this.feedHash = hash(title);
+    this.headlines.push({ time: this.clock.now, title: title });
+
+    if (this.loopTimer) {
+      this.clock.cancel(this.loopTimer);
+      this.loopTimer = null;
+    }
+
+    if (!this.settings.pullMode) {
+      return;
+    }
+
+    // feed_loop_end after every scroll loop
+    var period = FEED_WAIT_TIME_LIMIT * PROMPT_DELTA + length * MARQUEE_DELTA;
+    var loop = function() {
+      self.wake();
+      self.counters.next++;
+      self.send({ msgType: 4, feedHash: self.feedHash });
+      self.loopTimer = self.clock.schedule(loop, period, 'watch');
+    };
+
+    this.loopTimer = this.clock.schedule(loop, period, 'watch');
+  }
+};
@@ -0,0 +1,1699 @@
+/*
+ * Pebble Term Watch
+ *
+ * Stand-in SDK for the host build (see pebble.h).
+ *
+ * Time only moves in sdk_run_until: due timers and ticks fire in deadline
+ * order and the window is redrawn (one frame) whenever an instant left a
+ * layer dirty. Wakeups count the instants the app ran for a timer or a
+ * tick; messages, bluetooth and battery events are counted apart.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pebble.h>
+#include <stdarg.h>
+#include "sdk_host.h"
+#include "resource_data.auto.h"
+
+#define SCREEN_WIDTH (144)
+#define SCREEN_HEIGHT (168)
+#define SCREEN_ROW_SIZE (20)
+
+// Droid Sans Mono 13: advance and line height
+#define GLYPH_WIDTH (8)
+#define GLYPH_HEIGHT (15)
+
+#define SDK_MAX_TIMERS (32)
+#define SDK_MAX_PERSIST (64)
+
+SdkCounters sdk_counters;
+
+static SdkHooks hooks;
+static uint64_t now_ms;
+static uint64_t launch_ms;
+static uint64_t launch_ns;
+static uint64_t last_wake_ms = UINT64_MAX;
+static int app_depth = 0;
+
+static uint64_t cpu_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// App code runs between these, nested calls are counted once
+static uint64_t app_enter(void) {
+  return app_depth++ ? 0 : cpu_ns();
+}
+
+static void app_leave(uint64_t start) {
+  if (--app_depth == 0) {
+    sdk_counters.app_ns += cpu_ns() - start;
+  }
+}
+
+#define APP_CALL(call) do { \
+  uint64_t app_start_ = app_enter(); \
+  call; \
+  app_leave(app_start_); \
+} while (0)
+
+// logging
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+             const char *fmt, ...) {
+  char line[256];
+  int len;
+  va_list args;
+
+  len = snprintf(line, sizeof(line), "%s:%d: ", src_filename, src_line_number);
+  va_start(args, fmt);
+  vsnprintf(line + len, sizeof(line) - len, fmt, args);
+  va_end(args);
+
+  sdk_counters.log_ns = cpu_ns() - launch_ns;
+  if (hooks.log) {
+    hooks.log(line);
+  }
+}
+
+// time
+
+time_t sdk_time(time_t *t) {
+  time_t sec = (time_t)(now_ms / 1000);
+
+  if (t) {
+    *t = sec;
+  }
+  return sec;
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+  uint16_t ms = (uint16_t)(now_ms % 1000);
+
+  if (t_utc) {
+    *t_utc = (time_t)(now_ms / 1000);
+  }
+  if (out_ms) {
+    *out_ms = ms;
+  }
+  return ms;
+}
+
+bool clock_is_24h_style(void) {
+  return true;
+}
+
+uint64_t sdk_now(void) {
+  return now_ms;
+}
+
+// framebuffer
+
+static uint8_t framebuffer[SCREEN_HEIGHT * SCREEN_ROW_SIZE];
+
+struct GContext {
+  GPoint offset;
+  GRect clip;
+  GColor stroke_color;
+  GColor fill_color;
+  GColor text_color;
+  GCompOp compositing_mode;
+};
+
+static GRect rect_intersect(GRect a, GRect b) {
+  int16_t x0 = MAX(a.origin.x, b.origin.x);
+  int16_t y0 = MAX(a.origin.y, b.origin.y);
+  int16_t x1 = MIN(a.origin.x + a.size.w, b.origin.x + b.size.w);
+  int16_t y1 = MIN(a.origin.y + a.size.h, b.origin.y + b.size.h);
+
+  if (x1 <= x0 || y1 <= y0) {
+    return GRectZero;
+  }
+  return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+static bool fb_get(int x, int y) {
+  return (framebuffer[y * SCREEN_ROW_SIZE + x / 8] >> (x % 8)) & 1;
+}
+
+static void fb_put(int x, int y, bool white) {
+  uint8_t *byte = &framebuffer[y * SCREEN_ROW_SIZE + x / 8];
+
+  if (white) {
+    *byte |= (uint8_t)(1 << (x % 8));
+  } else {
+    *byte &= (uint8_t)~(1 << (x % 8));
+  }
+}
+
+static bool clip_contains(const GContext *ctx, int x, int y) {
+  return x >= ctx->clip.origin.x && x < ctx->clip.origin.x + ctx->clip.size.w
+      && y >= ctx->clip.origin.y && y < ctx->clip.origin.y + ctx->clip.size.h;
+}
+
+static void fb_fill(const GContext *ctx, GRect rect, GColor color) {
+  if (color == GColorClear) {
+    return;
+  }
+
+  GRect area = rect_intersect(ctx->clip, GRect(rect.origin.x + ctx->offset.x,
+                                               rect.origin.y + ctx->offset.y,
+                                               rect.size.w, rect.size.h));
+
+  for (int y = area.origin.y; y < area.origin.y + area.size.h; y++) {
+    for (int x = area.origin.x; x < area.origin.x + area.size.w; x++) {
+      fb_put(x, y, color == GColorWhite);
+    }
+  }
+}
+
+static void fb_composite(int x, int y, bool src, GCompOp op) {
+  bool dst = fb_get(x, y);
+
+  switch (op) {
+    case GCompOpAssign: dst = src; break;
+    case GCompOpAssignInverted: dst = !src; break;
+    case GCompOpOr: dst = dst || src; break;
+    case GCompOpAnd: dst = dst && src; break;
+    case GCompOpClear: dst = dst && !src; break;
+    case GCompOpSet: dst = dst || !src; break;
+  }
+  fb_put(x, y, dst);
+}
+
+// graphics
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->compositing_mode = mode;
+}
+
+void graphics_draw_pixel(GContext *ctx, GPoint point) {
+  fb_fill(ctx, GRect(point.x, point.y, 1, 1), ctx->stroke_color);
+}
+
+void graphics_draw_rect(GContext *ctx, GRect rect) {
+  fb_fill(ctx, GRect(rect.origin.x, rect.origin.y, rect.size.w, 1), ctx->stroke_color);
+  fb_fill(ctx, GRect(rect.origin.x, rect.origin.y + rect.size.h - 1, rect.size.w, 1), ctx->stroke_color);
+  fb_fill(ctx, GRect(rect.origin.x, rect.origin.y, 1, rect.size.h), ctx->stroke_color);
+  fb_fill(ctx, GRect(rect.origin.x + rect.size.w - 1, rect.origin.y, 1, rect.size.h), ctx->stroke_color);
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+                        GCornerMask corner_mask) {
+  fb_fill(ctx, rect, ctx->fill_color);
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  if (bitmap == NULL || bitmap->bounds.size.w == 0 || bitmap->bounds.size.h == 0) {
+    return;
+  }
+
+  const uint8_t *rows = bitmap->addr;
+  int x0 = rect.origin.x + ctx->offset.x;
+  int y0 = rect.origin.y + ctx->offset.y;
+
+  // tiled like the SDK when the rect is larger than the bitmap
+  for (int y = 0; y < rect.size.h; y++) {
+    for (int x = 0; x < rect.size.w; x++) {
+      if (!clip_contains(ctx, x0 + x, y0 + y)) {
+        continue;
+      }
+      int bx = bitmap->bounds.origin.x + x % bitmap->bounds.size.w;
+      int by = bitmap->bounds.origin.y + y % bitmap->bounds.size.h;
+      bool src = (rows[by * bitmap->row_size_bytes + bx / 8] >> (bx % 8)) & 1;
+
+      fb_composite(x0 + x, y0 + y, src, ctx->compositing_mode);
+    }
+  }
+}
+
+// A box per glyph, with a bar that differs by character
+static void draw_glyph(GContext *ctx, int x, int y, char c) {
+  GColor color = ctx->text_color;
+
+  fb_fill(ctx, GRect(x + 1, y + 3, 6, 1), color);
+  fb_fill(ctx, GRect(x + 1, y + 11, 6, 1), color);
+  fb_fill(ctx, GRect(x + 1, y + 3, 1, 9), color);
+  fb_fill(ctx, GRect(x + 6, y + 3, 1, 9), color);
+  fb_fill(ctx, GRect(x + 2, y + 4 + (c & 7), 4, 1), color);
+  sdk_counters.glyphs++;
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment,
+                        void *layout) {
+  int columns = box.size.w / GLYPH_WIDTH;
+  int y = box.origin.y;
+
+  if (text == NULL || columns <= 0) {
+    return;
+  }
+
+  while (*text != '\0' && y + GLYPH_HEIGHT <= box.origin.y + box.size.h + GLYPH_HEIGHT / 2) {
+    int len = 0;
+
+    // characters up to the newline or the width (no word breaks)
+    while (text[len] != '\0' && text[len] != '\n' && len < columns) {
+      len++;
+    }
+
+    int x = box.origin.x;
+    if (alignment == GTextAlignmentCenter) {
+      x += (box.size.w - len * GLYPH_WIDTH) / 2;
+    } else if (alignment == GTextAlignmentRight) {
+      x += box.size.w - len * GLYPH_WIDTH;
+    }
+
+    for (int i = 0; i < len; i++) {
+      if (text[i] != ' ') {
+        draw_glyph(ctx, x + i * GLYPH_WIDTH, y, text[i]);
+      }
+    }
+
+    text += len;
+    if (*text == '\n') {
+      text++;
+    }
+    y += GLYPH_HEIGHT;
+
+    if (overflow_mode != GTextOverflowModeWordWrap) {
+      break;
+    }
+  }
+}
+
+// bitmaps, fonts and resources
+
+GBitmap *gbitmap_create_blank(GSize size) {
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+
+  bitmap->row_size_bytes = (uint16_t)((size.w + 31) / 32 * 4);
+  bitmap->addr = calloc(1, bitmap->row_size_bytes * size.h + 1);
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  if (resource_id < 1 || resource_id > RESOURCE_COUNT) {
+    return NULL;
+  }
+
+  const SdkResource *resource = &sdk_resources[resource_id - 1];
+
+  if (resource->data == NULL) {
+    return NULL;
+  }
+
+  GBitmap *bitmap = gbitmap_create_blank(GSize(resource->width, resource->height));
+  memcpy(bitmap->addr, resource->data, resource->row_size * resource->height);
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (bitmap) {
+    free(bitmap->addr);
+    free(bitmap);
+  }
+}
+
+struct GFontInfo {
+  uint32_t resource_id;
+};
+
+static struct GFontInfo system_font;
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return resource_id;
+}
+
+GFont fonts_load_custom_font(ResHandle handle) {
+  GFont font = calloc(1, sizeof(struct GFontInfo));
+
+  font->resource_id = handle;
+  return font;
+}
+
+void fonts_unload_custom_font(GFont font) {
+  free(font);
+}
+
+GFont fonts_get_system_font(const char *font_key) {
+  return &system_font;
+}
+
+// layers
+
+typedef enum {
+  LAYER_PLAIN,
+  LAYER_TEXT,
+  LAYER_BITMAP,
+  LAYER_INVERTER
+} LayerKind;
+
+struct Layer {
+  GRect frame;
+  GRect bounds;
+  bool hidden;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+  LayerUpdateProc update_proc;
+  LayerKind kind;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GColor text_color;
+  GColor background_color;
+  GFont font;
+  GTextAlignment alignment;
+  GTextOverflowMode overflow_mode;
+};
+
+struct BitmapLayer {
+  Layer layer;
+  const GBitmap *bitmap;
+  GColor background_color;
+  GCompOp compositing_mode;
+  GAlign alignment;
+};
+
+struct InverterLayer {
+  Layer layer;
+};
+
+struct Window {
+  Layer root;
+  GColor background_color;
+  WindowHandlers handlers;
+  bool loaded;
+};
+
+static Window *top_window = NULL;
+static bool screen_dirty = false;
+
+static void layer_init(Layer *layer, GRect frame, LayerKind kind) {
+  memset(layer, 0, sizeof(*layer));
+  layer->frame = frame;
+  layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+  layer->kind = kind;
+}
+
+static void layer_deinit(Layer *layer) {
+  layer_remove_from_parent(layer);
+
+  for (Layer *child = layer->first_child; child != NULL; ) {
+    Layer *next = child->next_sibling;
+    child->parent = NULL;
+    child->next_sibling = NULL;
+    child = next;
+  }
+}
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = malloc(sizeof(Layer));
+
+  layer_init(layer, frame, LAYER_PLAIN);
+  return layer;
+}
+
+void layer_destroy(Layer *layer) {
+  if (layer) {
+    layer_deinit(layer);
+    free(layer);
+  }
+}
+
+void layer_mark_dirty(Layer *layer) {
+  sdk_counters.dirty++;
+  screen_dirty = true;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+  layer->frame = frame;
+  layer->bounds.size = frame.size;
+  layer_mark_dirty(layer);
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+void layer_set_bounds(Layer *layer, GRect bounds) {
+  layer->bounds = bounds;
+  layer_mark_dirty(layer);
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove_from_parent(child);
+
+  Layer **next = &parent->first_child;
+  while (*next != NULL) {
+    next = &(*next)->next_sibling;
+  }
+  *next = child;
+  child->parent = parent;
+  layer_mark_dirty(parent);
+}
+
+void layer_remove_from_parent(Layer *child) {
+  if (child == NULL || child->parent == NULL) {
+    return;
+  }
+
+  Layer **next = &child->parent->first_child;
+  while (*next != child) {
+    next = &(*next)->next_sibling;
+  }
+  *next = child->next_sibling;
+  layer_mark_dirty(child->parent);
+  child->parent = NULL;
+  child->next_sibling = NULL;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  if (layer->hidden != hidden) {
+    layer->hidden = hidden;
+    layer_mark_dirty(layer);
+  }
+}
+
+bool layer_get_hidden(const Layer *layer) {
+  return layer->hidden;
+}
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = calloc(1, sizeof(TextLayer));
+
+  layer_init(&text_layer->layer, frame, LAYER_TEXT);
+  text_layer->text_color = GColorBlack;
+  text_layer->background_color = GColorWhite;
+  text_layer->font = &system_font;
+  text_layer->overflow_mode = GTextOverflowModeWordWrap;
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if (text_layer) {
+    layer_deinit(&text_layer->layer);
+    free(text_layer);
+  }
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+// The SDK keeps the pointer and lays the text out on the next frame
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  sdk_counters.text_sets++;
+  text_layer->text = text;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+const char *text_layer_get_text(TextLayer *text_layer) {
+  return text_layer->text;
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  text_layer->text_color = color;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  text_layer->background_color = color;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment alignment) {
+  text_layer->alignment = alignment;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode) {
+  text_layer->overflow_mode = line_mode;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+BitmapLayer *bitmap_layer_create(GRect frame) {
+  BitmapLayer *bitmap_layer = calloc(1, sizeof(BitmapLayer));
+
+  layer_init(&bitmap_layer->layer, frame, LAYER_BITMAP);
+  bitmap_layer->background_color = GColorClear;
+  bitmap_layer->compositing_mode = GCompOpAssign;
+  bitmap_layer->alignment = GAlignCenter;
+  return bitmap_layer;
+}
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer) {
+  if (bitmap_layer) {
+    layer_deinit(&bitmap_layer->layer);
+    free(bitmap_layer);
+  }
+}
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer) {
+  return (Layer *)&bitmap_layer->layer;
+}
+
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap) {
+  bitmap_layer->bitmap = bitmap;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+void bitmap_layer_set_alignment(BitmapLayer *bitmap_layer, GAlign alignment) {
+  bitmap_layer->alignment = alignment;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+void bitmap_layer_set_background_color(BitmapLayer *bitmap_layer, GColor color) {
+  bitmap_layer->background_color = color;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+void bitmap_layer_set_compositing_mode(BitmapLayer *bitmap_layer, GCompOp mode) {
+  bitmap_layer->compositing_mode = mode;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+InverterLayer *inverter_layer_create(GRect frame) {
+  InverterLayer *inverter_layer = calloc(1, sizeof(InverterLayer));
+
+  layer_init(&inverter_layer->layer, frame, LAYER_INVERTER);
+  return inverter_layer;
+}
+
+void inverter_layer_destroy(InverterLayer *inverter_layer) {
+  if (inverter_layer) {
+    layer_deinit(&inverter_layer->layer);
+    free(inverter_layer);
+  }
+}
+
+Layer *inverter_layer_get_layer(InverterLayer *inverter_layer) {
+  return &inverter_layer->layer;
+}
+
+// rendering
+
+static void draw_layer(Layer *layer, GContext *ctx) {
+  switch (layer->kind) {
+    case LAYER_TEXT: {
+      TextLayer *text_layer = (TextLayer *)layer;
+
+      fb_fill(ctx, layer->bounds, text_layer->background_color);
+      ctx->text_color = text_layer->text_color;
+      graphics_draw_text(ctx, text_layer->text, text_layer->font, layer->bounds,
+                         text_layer->overflow_mode, text_layer->alignment, NULL);
+      break;
+    }
+    case LAYER_BITMAP: {
+      BitmapLayer *bitmap_layer = (BitmapLayer *)layer;
+      const GBitmap *bitmap = bitmap_layer->bitmap;
+
+      fb_fill(ctx, layer->bounds, bitmap_layer->background_color);
+      if (bitmap) {
+        GSize size = bitmap->bounds.size;
+        GRect rect = GRect(0, 0, size.w, size.h);
+
+        if (bitmap_layer->alignment == GAlignCenter) {
+          rect.origin = GPoint((layer->bounds.size.w - size.w) / 2,
+                               (layer->bounds.size.h - size.h) / 2);
+        }
+        ctx->compositing_mode = bitmap_layer->compositing_mode;
+        graphics_draw_bitmap_in_rect(ctx, bitmap, rect);
+      }
+      break;
+    }
+    case LAYER_INVERTER:
+      for (int y = ctx->clip.origin.y; y < ctx->clip.origin.y + ctx->clip.size.h; y++) {
+        for (int x = ctx->clip.origin.x; x < ctx->clip.origin.x + ctx->clip.size.w; x++) {
+          fb_put(x, y, !fb_get(x, y));
+        }
+      }
+      break;
+    case LAYER_PLAIN:
+      break;
+  }
+}
+
+static void render_layer(Layer *layer, GPoint origin, GRect clip) {
+  if (layer->hidden) {
+    return;
+  }
+
+  GPoint frame_origin = GPoint(origin.x + layer->frame.origin.x,
+                               origin.y + layer->frame.origin.y);
+  GContext ctx = {
+    .offset = GPoint(frame_origin.x + layer->bounds.origin.x,
+                     frame_origin.y + layer->bounds.origin.y),
+    .clip = rect_intersect(clip, GRect(frame_origin.x, frame_origin.y,
+                                       layer->frame.size.w, layer->frame.size.h)),
+    .stroke_color = GColorBlack,
+    .fill_color = GColorBlack,
+    .text_color = GColorWhite,
+    .compositing_mode = GCompOpAssign
+  };
+
+  if (layer->update_proc) {
+    layer->update_proc(layer, &ctx);
+  } else {
+    draw_layer(layer, &ctx);
+  }
+
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+    render_layer(child, ctx.offset, ctx.clip);
+  }
+}
+
+void sdk_flush(void) {
+  if (!screen_dirty || top_window == NULL || !top_window->loaded) {
+    return;
+  }
+
+  uint64_t start = cpu_ns();
+
+  screen_dirty = false;
+  memset(framebuffer, top_window->background_color == GColorWhite ? 0xFF : 0x00,
+         sizeof(framebuffer));
+  render_layer(&top_window->root, GPointZero, GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT));
+
+  uint64_t end = cpu_ns();
+
+  sdk_counters.render_ns += end - start;
+  if (sdk_counters.frames++ == 0) {
+    sdk_counters.first_frame_ms = (int64_t)(now_ms - launch_ms);
+    sdk_counters.first_frame_ns = end - launch_ns;
+  }
+}
+
+bool sdk_screenshot(const char *path) {
+  FILE *f = fopen(path, "wb");
+
+  if (f == NULL) {
+    return false;
+  }
+
+  // PBM: 1 is black, most significant bit first
+  fprintf(f, "P4\n%d %d\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+  for (int y = 0; y < SCREEN_HEIGHT; y++) {
+    for (int i = 0; i < SCREEN_WIDTH / 8; i++) {
+      uint8_t in = framebuffer[y * SCREEN_ROW_SIZE + i];
+      uint8_t out = 0;
+
+      for (int bit = 0; bit < 8; bit++) {
+        if (!(in & (1 << bit))) {
+          out |= (uint8_t)(0x80 >> bit);
+        }
+      }
+      fputc(out, f);
+    }
+  }
+  return fclose(f) == 0;
+}
+
+static void layer_text(Layer *layer, void (*each)(const char *text)) {
+  if (layer->hidden) {
+    return;
+  }
+
+  if (layer->kind == LAYER_TEXT) {
+    const char *text = ((TextLayer *)layer)->text;
+
+    if (text && *text) {
+      each(text);
+    }
+  }
+
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+    layer_text(child, each);
+  }
+}
+
+void sdk_screen_text(void (*each)(const char *text)) {
+  if (top_window != NULL && top_window->loaded) {
+    layer_text(&top_window->root, each);
+  }
+}
+
+// windows
+
+Window *window_create(void) {
+  Window *window = calloc(1, sizeof(Window));
+
+  layer_init(&window->root, GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT), LAYER_PLAIN);
+  window->background_color = GColorWhite;
+  return window;
+}
+
+void window_destroy(Window *window) {
+  if (window) {
+    if (top_window == window) {
+      top_window = NULL;
+    }
+    layer_deinit(&window->root);
+    free(window);
+  }
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *)&window->root;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->background_color = background_color;
+  screen_dirty = true;
+}
+
+void window_stack_push(Window *window, bool animated) {
+  top_window = window;
+
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load) {
+      APP_CALL(window->handlers.load(window));
+    }
+  }
+  if (window->handlers.appear) {
+    APP_CALL(window->handlers.appear(window));
+  }
+  screen_dirty = true;
+}
+
+void window_stack_pop_all(const bool animated) {
+  Window *window = top_window;
+
+  if (window == NULL) {
+    return;
+  }
+  top_window = NULL;
+
+  if (window->handlers.disappear) {
+    APP_CALL(window->handlers.disappear(window));
+  }
+  if (window->loaded && window->handlers.unload) {
+    window->loaded = false;
+    APP_CALL(window->handlers.unload(window));
+  }
+}
+
+// timers
+
+typedef struct {
+  uint32_t id;      // 0: free
+  uint64_t at;
+  uint32_t seq;
+  AppTimerCallback callback;
+  void *data;
+} SdkTimer;
+
+static SdkTimer timers[SDK_MAX_TIMERS];
+static uint32_t timer_ids = 0;
+static uint32_t timer_seq = 0;
+
+// handles are ids, a stale one is harmless like on the watch
+static SdkTimer *timer_find(AppTimer *handle) {
+  uint32_t id = (uint32_t)(uintptr_t)handle;
+
+  for (int i = 0; id != 0 && i < SDK_MAX_TIMERS; i++) {
+    if (timers[i].id == id) {
+      return &timers[i];
+    }
+  }
+  return NULL;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+                             void *callback_data) {
+  for (int i = 0; i < SDK_MAX_TIMERS; i++) {
+    if (timers[i].id == 0) {
+      timers[i] = (SdkTimer) {
+        .id = ++timer_ids,
+        .at = now_ms + timeout_ms,
+        .seq = ++timer_seq,
+        .callback = callback,
+        .data = callback_data
+      };
+      return (AppTimer *)(uintptr_t)timers[i].id;
+    }
+  }
+
+  APP_LOG(APP_LOG_LEVEL_ERROR, "sdk: out of timers");
+  return NULL;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  SdkTimer *timer = timer_find(timer_handle);
+
+  if (timer == NULL) {
+    return false;
+  }
+  timer->at = now_ms + new_timeout_ms;
+  timer->seq = ++timer_seq;
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  SdkTimer *timer = timer_find(timer_handle);
+
+  if (timer) {
+    timer->id = 0;
+  }
+}
+
+static SdkTimer *timer_next(void) {
+  SdkTimer *next = NULL;
+
+  for (int i = 0; i < SDK_MAX_TIMERS; i++) {
+    if (timers[i].id != 0 && (next == NULL || timers[i].at < next->at
+                              || (timers[i].at == next->at && timers[i].seq < next->seq))) {
+      next = &timers[i];
+    }
+  }
+  return next;
+}
+
+// tick timer service
+
+static TickHandler tick_handler = NULL;
+static TimeUnits tick_units = 0;
+static uint64_t tick_at = UINT64_MAX;
+static struct tm tick_last;
+
+static uint64_t tick_period(void) {
+  return (tick_units & SECOND_UNIT) ? 1000 :
+         (tick_units & MINUTE_UNIT) ? 60 * 1000 :
+         (tick_units & HOUR_UNIT) ? 60 * 60 * 1000 : 24 * 60 * 60 * 1000;
+}
+
+static void tick_schedule(void) {
+  uint64_t period = tick_period();
+
+  tick_at = (now_ms / period + 1) * period;
+}
+
+void tick_timer_service_subscribe(TimeUnits tick_units_, TickHandler handler) {
+  time_t now = (time_t)(now_ms / 1000);
+
+  tick_handler = handler;
+  tick_units = tick_units_;
+  localtime_r(&now, &tick_last);
+  tick_schedule();
+}
+
+void tick_timer_service_unsubscribe(void) {
+  tick_handler = NULL;
+  tick_at = UINT64_MAX;
+}
+
+static void tick_fire(void) {
+  time_t now = (time_t)(now_ms / 1000);
+  struct tm t;
+  TimeUnits changed = SECOND_UNIT;
+
+  localtime_r(&now, &t);
+  if (t.tm_min != tick_last.tm_min) changed |= MINUTE_UNIT;
+  if (t.tm_hour != tick_last.tm_hour) changed |= HOUR_UNIT;
+  if (t.tm_mday != tick_last.tm_mday) changed |= DAY_UNIT;
+  if (t.tm_mon != tick_last.tm_mon) changed |= MONTH_UNIT;
+  if (t.tm_year != tick_last.tm_year) changed |= YEAR_UNIT;
+  tick_last = t;
+
+  tick_schedule();
+  sdk_counters.ticks++;
+  APP_CALL(tick_handler(&t, changed));
+}
+
+// event loop
+
+uint64_t sdk_next_deadline(void) {
+  SdkTimer *timer = timer_next();
+  uint64_t at = tick_handler ? tick_at : UINT64_MAX;
+
+  return timer && timer->at < at ? timer->at : at;
+}
+
+static void wake(void) {
+  if (last_wake_ms != now_ms) {
+    last_wake_ms = now_ms;
+    sdk_counters.wakeups++;
+  }
+}
+
+void sdk_run_until(uint64_t until_ms) {
+  for (;;) {
+    SdkTimer *timer = timer_next();
+    uint64_t at = sdk_next_deadline();
+
+    if (at == UINT64_MAX || at > until_ms) {
+      break;
+    }
+
+    if (at > now_ms) {
+      // what the last instant changed is on screen before time moves on
+      sdk_flush();
+      now_ms = at;
+    }
+    wake();
+
+    if (timer && timer->at <= at) {
+      AppTimerCallback callback = timer->callback;
+      void *data = timer->data;
+
+      timer->id = 0;
+      sdk_counters.timers++;
+      APP_CALL(callback(data));
+    } else {
+      tick_fire();
+    }
+  }
+
+  sdk_flush();
+  if (until_ms > now_ms) {
+    now_ms = until_ms;
+  }
+}
+
+size_t heap_bytes_used(void) {
+  return 0;
+}
+
+void app_event_loop(void) {
+  sdk_flush();
+  if (hooks.event_loop) {
+    hooks.event_loop();
+  }
+}
+
+// services
+
+static BatteryChargeState battery_state = { .charge_percent = 80 };
+static BatteryStateHandler battery_handler = NULL;
+static bool bluetooth_connected = true;
+static BluetoothConnectionHandler bluetooth_handler = NULL;
+static AccelTapHandler tap_handler = NULL;
+
+BatteryChargeState battery_state_service_peek(void) {
+  return battery_state;
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+  battery_handler = handler;
+}
+
+void battery_state_service_unsubscribe(void) {
+  battery_handler = NULL;
+}
+
+void sdk_battery(uint8_t percent, bool charging) {
+  battery_state.charge_percent = percent;
+  battery_state.is_charging = charging;
+  battery_state.is_plugged = charging;
+
+  wake();
+  if (battery_handler) {
+    APP_CALL(battery_handler(battery_state));
+  }
+  sdk_flush();
+}
+
+bool bluetooth_connection_service_peek(void) {
+  return bluetooth_connected;
+}
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler) {
+  bluetooth_handler = handler;
+}
+
+void bluetooth_connection_service_unsubscribe(void) {
+  bluetooth_handler = NULL;
+}
+
+void sdk_bluetooth(bool connected) {
+  bluetooth_connected = connected;
+
+  wake();
+  if (bluetooth_handler) {
+    APP_CALL(bluetooth_handler(connected));
+  }
+  sdk_flush();
+}
+
+void accel_tap_service_subscribe(AccelTapHandler handler) {
+  tap_handler = handler;
+}
+
+void accel_tap_service_unsubscribe(void) {
+  tap_handler = NULL;
+}
+
+void sdk_tap(void) {
+  wake();
+  if (tap_handler) {
+    APP_CALL(tap_handler(ACCEL_AXIS_Y, 1));
+  }
+  sdk_flush();
+}
+
+static void vibe(const char *kind) {
+  sdk_counters.vibes++;
+  if (hooks.vibe) {
+    hooks.vibe(kind);
+  }
+}
+
+void vibes_short_pulse(void) {
+  vibe("short");
+}
+
+void vibes_long_pulse(void) {
+  vibe("long");
+}
+
+void vibes_double_pulse(void) {
+  vibe("double");
+}
+
+void vibes_enqueue_custom_pattern(VibePattern pattern) {
+  vibe("custom");
+}
+
+void vibes_cancel(void) {
+}
+
+// persistent storage
+
+typedef struct {
+  uint32_t key;
+  uint16_t size;
+  bool used;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} SdkPersist;
+
+static SdkPersist persist[SDK_MAX_PERSIST];
+
+static SdkPersist *persist_find(uint32_t key) {
+  for (int i = 0; i < SDK_MAX_PERSIST; i++) {
+    if (persist[i].used && persist[i].key == key) {
+      return &persist[i];
+    }
+  }
+  return NULL;
+}
+
+bool persist_exists(const uint32_t key) {
+  return persist_find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+  SdkPersist *entry = persist_find(key);
+
+  return entry ? entry->size : E_DOES_NOT_EXIST;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  SdkPersist *entry = persist_find(key);
+
+  if (entry == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+
+  size_t size = MIN(buffer_size, entry->size);
+  memcpy(buffer, entry->data, size);
+  return (int)size;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size) {
+  int size = persist_read_data(key, buffer, buffer_size);
+
+  if (size > 0) {
+    buffer[MIN((size_t)size, buffer_size) - 1] = '\0';
+  }
+  return size;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  SdkPersist *entry = persist_find(key);
+
+  for (int i = 0; entry == NULL && i < SDK_MAX_PERSIST; i++) {
+    if (!persist[i].used) {
+      entry = &persist[i];
+    }
+  }
+  if (entry == NULL) {
+    return E_OUT_OF_STORAGE;
+  }
+
+  entry->used = true;
+  entry->key = key;
+  entry->size = (uint16_t)MIN(size, PERSIST_DATA_MAX_LENGTH);
+  memcpy(entry->data, data, entry->size);
+
+  sdk_counters.persist_writes++;
+  sdk_counters.persist_bytes += entry->size;
+  return entry->size;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_string(const uint32_t key, const char *cstring) {
+  return persist_write_data(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key) {
+  SdkPersist *entry = persist_find(key);
+
+  if (entry == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+  entry->used = false;
+  return S_SUCCESS;
+}
+
+// file: (uint32 key, uint16 size, data) records, host byte order
+bool sdk_persist_load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+
+  if (f == NULL) {
+    return false;
+  }
+  while (fread(&key, sizeof(key), 1, f) == 1 && fread(&size, sizeof(size), 1, f) == 1
+         && size <= sizeof(data) && fread(data, 1, size, f) == size) {
+    persist_write_data(key, data, size);
+  }
+  fclose(f);
+
+  sdk_counters.persist_writes = 0;
+  sdk_counters.persist_bytes = 0;
+  return true;
+}
+
+bool sdk_persist_save(const char *path) {
+  FILE *f = fopen(path, "wb");
+
+  if (f == NULL) {
+    return false;
+  }
+  for (int i = 0; i < SDK_MAX_PERSIST; i++) {
+    if (persist[i].used) {
+      fwrite(&persist[i].key, sizeof(persist[i].key), 1, f);
+      fwrite(&persist[i].size, sizeof(persist[i].size), 1, f);
+      fwrite(persist[i].data, 1, persist[i].size, f);
+    }
+  }
+  return fclose(f) == 0;
+}
+
+// dictionaries
+
+#define TUPLE_HEADER_SIZE (sizeof(Tuple))
+
+uint32_t dict_calc_buffer_size_from_tuplets(const Tuplet *tuplets, const uint8_t tuplets_count) {
+  uint32_t size = sizeof(Dictionary);
+
+  for (int i = 0; i < tuplets_count; i++) {
+    switch (tuplets[i].type) {
+      case TUPLE_BYTE_ARRAY: size += TUPLE_HEADER_SIZE + tuplets[i].bytes.length; break;
+      case TUPLE_CSTRING: size += TUPLE_HEADER_SIZE + tuplets[i].cstring.length; break;
+      default: size += TUPLE_HEADER_SIZE + tuplets[i].integer.width; break;
+    }
+  }
+  return size;
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer, const uint16_t size) {
+  if (iter == NULL || buffer == NULL || size < sizeof(Dictionary)) {
+    return DICT_INVALID_ARGS;
+  }
+
+  iter->dictionary = (Dictionary *)buffer;
+  iter->dictionary->count = 0;
+  iter->cursor = iter->dictionary->head;
+  iter->end = buffer + size;
+  return DICT_OK;
+}
+
+static DictionaryResult dict_write(DictionaryIterator *iter, uint32_t key, TupleType type,
+                                   const void *data, uint16_t length) {
+  uint8_t *at = (uint8_t *)iter->cursor;
+
+  if (at + TUPLE_HEADER_SIZE + length > (const uint8_t *)iter->end) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+
+  iter->cursor->key = key;
+  iter->cursor->type = type;
+  iter->cursor->length = length;
+  if (length) {
+    memcpy(at + TUPLE_HEADER_SIZE, data, length);
+  }
+
+  iter->cursor = (Tuple *)(at + TUPLE_HEADER_SIZE + length);
+  iter->dictionary->count++;
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+                                 const uint8_t *data, const uint16_t size) {
+  return dict_write(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key,
+                                    const char *cstring) {
+  return dict_write(iter, key, TUPLE_CSTRING, cstring, cstring ? strlen(cstring) + 1 : 0);
+}
+
+// little endian like the watch
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+                                const void *integer, const uint8_t width_bytes,
+                                const bool is_signed) {
+  if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) {
+    return DICT_INVALID_ARGS;
+  }
+  return dict_write(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write_int(iter, key, &value, 1, false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+  return dict_write_int(iter, key, &value, 4, false);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write_int(iter, key, &value, 4, true);
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet * const tuplet) {
+  switch (tuplet->type) {
+    case TUPLE_BYTE_ARRAY:
+      return dict_write(iter, tuplet->key, TUPLE_BYTE_ARRAY, tuplet->bytes.data,
+                        tuplet->bytes.length);
+    case TUPLE_CSTRING:
+      return dict_write(iter, tuplet->key, TUPLE_CSTRING, tuplet->cstring.data,
+                        tuplet->cstring.data ? tuplet->cstring.length : 0);
+    case TUPLE_UINT:
+    case TUPLE_INT:
+      return dict_write_int(iter, tuplet->key, &tuplet->integer.storage,
+                            (uint8_t)tuplet->integer.width, tuplet->type == TUPLE_INT);
+  }
+  return DICT_INVALID_ARGS;
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  uint32_t size = (uint32_t)((uint8_t *)iter->cursor - (uint8_t *)iter->dictionary);
+
+  iter->end = iter->cursor;
+  return size;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+  uint8_t *at = (uint8_t *)iter->cursor;
+
+  if (at + TUPLE_HEADER_SIZE > (const uint8_t *)iter->end
+      || at + TUPLE_HEADER_SIZE + iter->cursor->length > (const uint8_t *)iter->end) {
+    return NULL;
+  }
+
+  Tuple *tuple = iter->cursor;
+  iter->cursor = (Tuple *)(at + TUPLE_HEADER_SIZE + tuple->length);
+  return tuple;
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+  iter->cursor = iter->dictionary->head;
+  return dict_read_next(iter);
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t * const buffer,
+                                   const uint16_t size) {
+  if (size < sizeof(Dictionary)) {
+    return NULL;
+  }
+
+  iter->dictionary = (Dictionary *)buffer;
+  iter->end = buffer + size;
+  return dict_read_first(iter);
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  DictionaryIterator copy = *iter;
+
+  for (Tuple *tuple = dict_read_first(&copy); tuple != NULL; tuple = dict_read_next(&copy)) {
+    if (tuple->key == key) {
+      return tuple;
+    }
+  }
+  return NULL;
+}
+
+// AppMessage
+
+static struct {
+  bool open;
+  uint32_t inbox_size;
+  uint32_t outbox_size;
+  uint8_t *outbox;
+  DictionaryIterator outbox_iter;
+  bool outbox_begun;
+  bool outbox_in_flight;
+  void *context;
+  AppMessageInboxReceived inbox_received;
+  AppMessageInboxDropped inbox_dropped;
+  AppMessageOutboxSent outbox_sent;
+  AppMessageOutboxFailed outbox_failed;
+} message;
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  if (message.open) {
+    return APP_MSG_INVALID_ARGS;
+  }
+
+  message.open = true;
+  message.inbox_size = size_inbound;
+  message.outbox_size = size_outbound;
+  message.outbox = malloc(size_outbound);
+  return message.outbox ? APP_MSG_OK : APP_MSG_OUT_OF_MEMORY;
+}
+
+void *app_message_set_context(void *context) {
+  void *previous = message.context;
+
+  message.context = context;
+  return previous;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = message.inbox_received;
+
+  message.inbox_received = received_callback;
+  return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  AppMessageInboxDropped previous = message.inbox_dropped;
+
+  message.inbox_dropped = dropped_callback;
+  return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  AppMessageOutboxSent previous = message.outbox_sent;
+
+  message.outbox_sent = sent_callback;
+  return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  AppMessageOutboxFailed previous = message.outbox_failed;
+
+  message.outbox_failed = failed_callback;
+  return previous;
+}
+
+void app_message_deregister_callbacks(void) {
+  message.inbox_received = NULL;
+  message.inbox_dropped = NULL;
+  message.outbox_sent = NULL;
+  message.outbox_failed = NULL;
+  message.context = NULL;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+  return 656;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+  return 636;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if (!message.open || iterator == NULL) {
+    return APP_MSG_INVALID_ARGS;
+  }
+  if (message.outbox_in_flight) {
+    sdk_counters.outbox_busy++;
+    return APP_MSG_BUSY;
+  }
+
+  dict_write_begin(&message.outbox_iter, message.outbox, (uint16_t)message.outbox_size);
+  message.outbox_begun = true;
+  *iterator = &message.outbox_iter;
+  return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+  if (!message.outbox_begun) {
+    return APP_MSG_INVALID_ARGS;
+  }
+  if (message.outbox_in_flight) {
+    sdk_counters.outbox_busy++;
+    return APP_MSG_BUSY;
+  }
+
+  uint32_t size = dict_write_end(&message.outbox_iter);
+
+  message.outbox_begun = false;
+  message.outbox_in_flight = true;
+  sdk_counters.outbox++;
+  sdk_counters.outbox_bytes += size;
+
+  if (hooks.outbox) {
+    hooks.outbox(message.outbox, (uint16_t)size);
+  }
+  return APP_MSG_OK;
+}
+
+void sdk_outbox_result(bool acked) {
+  if (!message.outbox_in_flight) {
+    return;
+  }
+  message.outbox_in_flight = false;
+
+  wake();
+  if (acked) {
+    if (message.outbox_sent) {
+      APP_CALL(message.outbox_sent(&message.outbox_iter, message.context));
+    }
+  } else {
+    sdk_counters.outbox_failed++;
+    if (message.outbox_failed) {
+      APP_CALL(message.outbox_failed(&message.outbox_iter,
+                                     bluetooth_connected ? APP_MSG_SEND_TIMEOUT : APP_MSG_NOT_CONNECTED,
+                                     message.context));
+    }
+  }
+  sdk_flush();
+}
+
+bool sdk_inbox(const uint8_t *data, uint16_t size) {
+  static uint8_t inbox[1024];
+  DictionaryIterator iter;
+
+  // the radio wakes the watch even for a message it drops
+  wake();
+  sdk_counters.inbox++;
+  sdk_counters.inbox_bytes += size;
+
+  if (!message.open || size > message.inbox_size || size > sizeof(inbox)
+      || message.inbox_received == NULL) {
+    sdk_counters.inbox_dropped++;
+    if (message.open && message.inbox_dropped) {
+      APP_CALL(message.inbox_dropped(APP_MSG_BUFFER_OVERFLOW, message.context));
+    }
+    return false;
+  }
+
+  memcpy(inbox, data, size);
+  dict_read_begin_from_buffer(&iter, inbox, size);
+  APP_CALL(message.inbox_received(&iter, message.context));
+  sdk_flush();
+  return true;
+}
+
+// AppSync: keeps the current value of every key it was given, merges
+// each message and reports every received key
+
+static AppSync *sync_active = NULL;
+
+static void sync_error(AppSync *s, DictionaryResult dict_error, AppMessageResult result) {
+  if (s->callback.error) {
+    s->callback.error(dict_error, result, s->callback.context);
+  }
+}
+
+static void sync_inbox_received(DictionaryIterator *received, void *context) {
+  AppSync *s = sync_active;
+  uint8_t *old_buffer;
+  uint8_t *new_buffer;
+  DictionaryIterator old_iter = { 0 }, new_iter = { 0 };
+
+  if (s == NULL) {
+    return;
+  }
+
+  old_buffer = malloc(s->buffer_size);
+  new_buffer = malloc(s->buffer_size);
+  memcpy(old_buffer, s->buffer, s->buffer_size);
+  dict_read_begin_from_buffer(&old_iter, old_buffer, s->buffer_size);
+  old_iter.end = (uint8_t *)old_buffer + ((uint8_t *)s->current_iter.end - s->buffer);
+
+  // current values, replaced by the received ones
+  dict_write_begin(&new_iter, new_buffer, s->buffer_size);
+  for (Tuple *tuple = dict_read_first(&old_iter); tuple != NULL; tuple = dict_read_next(&old_iter)) {
+    Tuple *update = dict_find(received, tuple->key);
+    Tuple *source = update ? update : tuple;
+
+    if (dict_write(&new_iter, source->key, source->type, source->value->data,
+                   source->length) != DICT_OK) {
+      sync_error(s, DICT_NOT_ENOUGH_STORAGE, APP_MSG_OK);
+      free(old_buffer);
+      free(new_buffer);
+      return;
+    }
+  }
+
+  uint32_t size = dict_write_end(&new_iter);
+
+  memcpy(s->buffer, new_buffer, size);
+  dict_read_begin_from_buffer(&s->current_iter, s->buffer, (uint16_t)size);
+  free(new_buffer);
+
+  // in the order they came, keys the app did not declare are ignored
+  DictionaryIterator iter = *received;
+  for (Tuple *tuple = dict_read_first(&iter); tuple != NULL; tuple = dict_read_next(&iter)) {
+    Tuple *current = dict_find(&s->current_iter, tuple->key);
+
+    if (current && s->callback.value_changed) {
+      s->callback.value_changed(tuple->key, current, dict_find(&old_iter, tuple->key),
+                                s->callback.context);
+    }
+  }
+  free(old_buffer);
+}
+
+static void sync_outbox_failed(DictionaryIterator *failed, AppMessageResult reason, void *context) {
+  if (sync_active) {
+    sync_error(sync_active, DICT_OK, reason);
+  }
+}
+
+static void sync_inbox_dropped(AppMessageResult reason, void *context) {
+  if (sync_active) {
+    sync_error(sync_active, DICT_OK, reason);
+  }
+}
+
+void app_sync_init(AppSync *s, uint8_t *buffer, const uint16_t buffer_size,
+                   const Tuplet * const keys_and_initial_values, const uint8_t count,
+                   AppSyncTupleChangedCallback tuple_changed_callback,
+                   AppSyncErrorCallback error_callback, void *context) {
+  memset(s, 0, sizeof(*s));
+  s->buffer = buffer;
+  s->buffer_size = buffer_size;
+  s->callback.value_changed = tuple_changed_callback;
+  s->callback.error = error_callback;
+  s->callback.context = context;
+
+  dict_write_begin(&s->current_iter, buffer, buffer_size);
+  for (int i = 0; i < count; i++) {
+    if (dict_write_tuplet(&s->current_iter, &keys_and_initial_values[i]) != DICT_OK) {
+      sync_error(s, DICT_NOT_ENOUGH_STORAGE, APP_MSG_OK);
+      return;
+    }
+  }
+  dict_write_end(&s->current_iter);
+
+  sync_active = s;
+  app_message_register_inbox_received(sync_inbox_received);
+  app_message_register_inbox_dropped(sync_inbox_dropped);
+  app_message_register_outbox_failed(sync_outbox_failed);
+
+  // the initial values are reported like received ones
+  DictionaryIterator iter = s->current_iter;
+  for (Tuple *tuple = dict_read_first(&iter); tuple != NULL; tuple = dict_read_next(&iter)) {
+    if (tuple_changed_callback) {
+      tuple_changed_callback(tuple->key, tuple, NULL, context);
+    }
+  }
+}
+
+void app_sync_deinit(AppSync *s) {
+  if (sync_active == s) {
+    sync_active = NULL;
+    app_message_deregister_callbacks();
+  }
+}
+
+AppMessageResult app_sync_set(AppSync *s, const Tuplet * const keys_and_values_to_update,
+                              const uint8_t count) {
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+
+  if (result != APP_MSG_OK) {
+    return result;
+  }
+  for (int i = 0; i < count; i++) {
+    dict_write_tuplet(iter, &keys_and_values_to_update[i]);
+  }
+  return app_message_outbox_send();
+}
+
+const Tuple *app_sync_get(const AppSync *s, const uint32_t key) {
+  return dict_find(&s->current_iter, key);
+}
+
+// setup
+
+void sdk_init(uint64_t start_ms, const SdkHooks *sdk_hooks) {
+  memset(&sdk_counters, 0, sizeof(sdk_counters));
+  sdk_counters.first_frame_ms = -1;
+  hooks = *sdk_hooks;
+  now_ms = launch_ms = start_ms;
+  launch_ns = cpu_ns();
+}
@@ -0,0 +1,85 @@
+/*
+ * Pebble Term Watch
+ *
+ * Host side of the stand-in SDK: what the watch would get from the
+ * firmware (time, messages, bluetooth, battery) and what it measures.
+ */
+#pragma once
+
+#include <pebble.h>
+
+typedef struct {
+  uint32_t wakeups;       // distinct instants the watch woke: timers, ticks,
+                          // messages, acks and the services
+  uint32_t timers;        // app timer callbacks
+  uint32_t ticks;         // tick handler calls
+  uint32_t frames;        // window redraws
+  uint32_t glyphs;        // characters drawn
+  uint32_t text_sets;     // text_layer_set_text calls
+  uint32_t dirty;         // layers marked dirty
+  uint32_t inbox;         // messages received
+  uint32_t inbox_bytes;
+  uint32_t inbox_dropped;
+  uint32_t outbox;        // messages sent
+  uint32_t outbox_bytes;
+  uint32_t outbox_busy;   // app_message_outbox_begin while one is in flight
+  uint32_t outbox_failed;
+  uint32_t persist_writes;
+  uint32_t persist_bytes;
+  uint32_t vibes;
+  uint64_t app_ns;        // host CPU in app callbacks
+  uint64_t render_ns;     // host CPU drawing frames
+  int64_t first_frame_ms; // virtual ms from launch, -1 before
+  uint64_t first_frame_ns;// host CPU from launch to the first frame
+  uint64_t log_ns;        // host CPU from launch to the last APP_LOG line
+} SdkCounters;
+
+typedef struct {
+  uint16_t width;
+  uint16_t height;
+  uint16_t row_size;
+  const uint8_t *data;
+} SdkResource;
+
+// Events the SDK hands to the host (watch_host.c)
+typedef struct {
+  void (*outbox)(const uint8_t *data, uint16_t size);
+  void (*vibe)(const char *kind);
+  void (*log)(const char *line);
+  void (*event_loop)(void);
+} SdkHooks;
+
+extern SdkCounters sdk_counters;
+
+void sdk_init(uint64_t now_ms, const SdkHooks *hooks);
+
+uint64_t sdk_now(void);
+
+// Fires timers and ticks due up to now_ms, drawing frames as they go
+void sdk_run_until(uint64_t now_ms);
+
+// Next timer or tick deadline, UINT64_MAX when nothing is scheduled
+uint64_t sdk_next_deadline(void);
+
+// AppMessage from the phone, false if it was dropped (nack)
+bool sdk_inbox(const uint8_t *data, uint16_t size);
+
+// The phone acked (or not) the message in flight, frees the outbox
+void sdk_outbox_result(bool acked);
+
+void sdk_bluetooth(bool connected);
+void sdk_battery(uint8_t percent, bool charging);
+void sdk_tap(void);
+
+// Redraws now if anything is dirty (the firmware does after each event)
+void sdk_flush(void);
+
+// Framebuffer as a PBM (P4) image
+bool sdk_screenshot(const char *path);
+
+// Text of every visible text layer with any, in drawing order
+void sdk_screen_text(void (*each)(const char *text));
+
+// Persistent storage from / to a file, to relaunch with the same state
+bool sdk_persist_load(const char *path);
+bool sdk_persist_save(const char *path);
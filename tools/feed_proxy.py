@@ -0,0 +1,132 @@
+#
+# Reference feed proxy: serves the compact headline list read by
+# Feed.parse in pebble-js-app.js instead of the whole RSS document.
+#
+#   GET /?url=<rss url>  ->  {"items": ["Headline", ...]}
+#
+# Titles are ASCII only, whitespace collapsed and cut to TITLE_MAX_LEN
+# with "...", so the phone skips DOMParser and toAscii. Responses carry an
+# ETag; a matching If-None-Match gets 304 with no body.
+#
+# Usage: python tools/feed_proxy.py [port] [--file feed.xml]
+#   --file serves a local RSS document for every url (offline testing)
+#
+
+import hashlib
+import json
+import re
+import sys
+import time
+import unicodedata
+import xml.etree.ElementTree as ElementTree
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from urllib.parse import parse_qs, urlparse
+    from urllib.request import urlopen
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from urlparse import parse_qs, urlparse
+    from urllib2 import urlopen
+
+# Keep in sync with Feed.TITLE_MAX_LEN (the watch buffer holds one less)
+TITLE_MAX_LEN = 120
+MAX_ITEMS = 10
+CACHE_SECONDS = 60
+
+local_file = None
+cache = {}
+
+
+def normalize(title):
+    if not isinstance(title, type(u'')):
+        title = title.decode('utf-8', 'replace')
+    title = unicodedata.normalize('NFKD', title)
+    title = title.encode('ascii', 'ignore').decode('ascii')
+    title = re.sub(r'\s+', ' ', title).strip()
+
+    if len(title) >= TITLE_MAX_LEN - 1:
+        title = title[:TITLE_MAX_LEN - 4].rstrip() + '...'
+    return title
+
+
+def read_feed(url):
+    if local_file:
+        with open(local_file, 'rb') as f:
+            return f.read()
+    return urlopen(url, timeout=10).read()
+
+
+def headlines(url):
+    now = time.time()
+    hit = cache.get(url)
+
+    if hit and now - hit[0] < CACHE_SECONDS:
+        return hit[1]
+
+    root = ElementTree.fromstring(read_feed(url))
+    items = []
+
+    # RSS <item> and Atom <entry>
+    for item in root.iter():
+        if item.tag.split('}')[-1] not in ('item', 'entry'):
+            continue
+        for child in item:
+            if child.tag.split('}')[-1] == 'title':
+                title = normalize(child.text or '')
+                if title:
+                    items.append(title)
+                break
+        if len(items) >= MAX_ITEMS:
+            break
+
+    body = json.dumps({'items': items}, separators=(',', ':')).encode('ascii')
+    etag = '"%s"' % hashlib.sha1(body).hexdigest()[:16]
+
+    cache[url] = (now, (body, etag))
+    return body, etag
+
+
+class Handler(BaseHTTPRequestHandler):
+
+    def do_GET(self):
+        query = parse_qs(urlparse(self.path).query)
+        url = query.get('url', [''])[0]
+
+        if not url and not local_file:
+            self.send_error(400, 'missing url')
+            return
+
+        try:
+            body, etag = headlines(url)
+        except Exception as e:
+            self.send_error(502, str(e))
+            return
+
+        if self.headers.get('If-None-Match') == etag:
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(body)))
+        self.send_header('ETag', etag)
+        self.end_headers()
+        self.wfile.write(body)
+
+
+if __name__ == '__main__':
+    args = sys.argv[1:]
+    port = 8080
+
+    if '--file' in args:
+        i = args.index('--file')
+        local_file = args[i + 1]
+        del args[i:i + 2]
+    if args:
+        port = int(args[0])
+
+    print('feed proxy on :%d' % port)
+    HTTPServer(('', port), Handler).serve_forever()
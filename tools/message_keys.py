@@ -0,0 +1,186 @@
+#
+# Generates the AppMessage bindings from message_keys.json:
+#   - C key enum, MSG_TYPE_* defines, AppSync initial tuplets
+#   - exact inbox, outbox and AppSync buffer sizes
+#   - JS key map and encoder
+#
+# Keys tagged with a "feature" only exist in builds of a profile that
+# has it (see PROFILES in tools/profiles.py).
+#
+# Usage: python tools/message_keys.py [message_keys.json] [feature,...]
+#   prints sizes, for the given features if any
+#
+
+import json
+import sys
+
+# dict_calc_buffer_size(): 1 byte count + 7 byte header per tuple
+DICT_HEADER = 1
+TUPLE_HEADER = 7
+
+# smallest payload a key carries when it is sent empty
+MIN_PAYLOAD = {'int': 1, 'cstring': 1, 'bytes': 0}
+
+
+def load(path):
+    with open(path) as f:
+        return json.load(f)
+
+
+def has(entry, features):
+    return 'feature' not in entry or entry['feature'] in features
+
+
+def select(schema, features):
+    """Copy of schema without the keys of features not in the build."""
+    selected = dict(schema)
+    selected['features'] = list(features)
+    selected['keys'] = [k for k in schema['keys'] if has(k, features)]
+    selected['phoneSettings'] = [k for k in schema.get('phoneSettings', [])
+                                 if has(k, features)]
+    return selected
+
+
+def dict_size(sizes):
+    return DICT_HEADER + sum(TUPLE_HEADER + size for size in sizes)
+
+
+def message_size(keys, direction):
+    """Worst case dictionary of every key sent in direction ('in'/'out').
+
+    Keys in the same group never carry a payload at the same time, so
+    only the largest one of a group is counted at full size.
+    """
+    sizes = []
+    groups = {}
+
+    for k in keys:
+        size = k.get(direction, 0)
+        if size <= 0:
+            continue
+
+        group = k.get('group')
+        if group is None:
+            sizes.append(size)
+        else:
+            groups.setdefault(group, []).append((size, MIN_PAYLOAD[k['type']]))
+
+    for members in groups.values():
+        members.sort(reverse=True)
+        sizes.append(members[0][0])
+        sizes.extend(minimum for _, minimum in members[1:])
+
+    return dict_size(sizes)
+
+
+def sync_size(keys):
+    """AppSync keeps the latest value of every key at once."""
+    return dict_size(max(k.get('in', 0), k.get('out', 0), MIN_PAYLOAD[k['type']])
+                     for k in keys)
+
+
+def sizes(schema):
+    keys = schema['keys']
+    return {
+        'inbox': message_size(keys, 'in'),
+        'outbox': message_size(keys, 'out'),
+        'sync': sync_size(keys)
+    }
+
+
+def tuplet(k):
+    if k['type'] == 'int':
+        return 'TupletInteger(%s, %s)' % (k['c'], k['initial'])
+    if k['type'] == 'cstring':
+        return 'TupletCString(%s, %s)' % (k['c'], k['initial'])
+    return 'TupletBytes(%s, NULL, 0)' % k['c']
+
+
+def c_header(schema):
+    s = sizes(schema)
+    keys = schema['keys']
+    msg_types = sorted(schema['msgTypes'].items(), key=lambda item: item[1])
+
+    lines = [
+        '// Generated from message_keys.json by wscript. Do not edit.',
+        '#pragma once',
+        '',
+        'enum {'
+    ]
+    lines.append(',\n'.join('  %s = 0x%X' % (k['c'], k['key']) for k in keys))
+    lines += ['};', '']
+
+    for name, value in msg_types:
+        lines.append('#define MSG_TYPE_%s ((uint8_t)%d)' % (name, value))
+
+    lines += [
+        '',
+        '#define MESSAGE_INBOX_SIZE (%d)' % s['inbox'],
+        '#define MESSAGE_OUTBOX_SIZE (%d)' % s['outbox'],
+        '#define MESSAGE_SYNC_BUFFER_SIZE (%d)' % s['sync'],
+        '',
+        '#define MESSAGE_INITIAL_VALUES { \\'
+    ]
+    lines.append(', \\\n'.join('  %s' % tuplet(k) for k in keys) + ' \\')
+    lines += ['}', '']
+
+    return '\n'.join(lines)
+
+
+def features(schema):
+    """Features of the build, every tagged one unless selected."""
+    if 'features' in schema:
+        return schema['features']
+    return sorted(set(k['feature'] for k in schema['keys'] if 'feature' in k))
+
+
+def js_source(schema):
+    keys = schema['keys']
+    msg_types = sorted(schema['msgTypes'].items(), key=lambda item: item[1])
+
+    lines = ['// Generated from message_keys.json by wscript. Do not edit.', '']
+    for name, value in msg_types:
+        lines.append('var MSG_TYPE_%s = %d;' % (name, value))
+
+    lines += ['', 'var MESSAGE_FEATURES = %s;' % json.dumps(features(schema))]
+
+    lines += ['', 'var MESSAGE_KEYS = {']
+    lines.append(',\n'.join('  %s: %d' % (k['name'], k['key']) for k in keys))
+    lines += [
+        '};',
+        '',
+        '// Maps names to numeric keys and drops anything the watch does not know',
+        'var encodeMessage = function(msg) {',
+        '  var out = {};',
+        '',
+        '  Object.keys(msg).forEach(function(name) {',
+        '    if (MESSAGE_KEYS.hasOwnProperty(name)) {',
+        '      out[MESSAGE_KEYS[name]] = msg[name];',
+        '    }',
+        '  });',
+        '  return out;',
+        '};',
+        ''
+    ]
+    return '\n'.join(lines)
+
+
+def check_appkeys(schema, appinfo):
+    """Returns a list of differences between appinfo.json appKeys and schema."""
+    expected = dict((k['name'], k['key']) for k in schema['keys'])
+    actual = appinfo.get('appKeys', {})
+    errors = []
+
+    for name in sorted(set(expected) | set(actual)):
+        if expected.get(name) != actual.get(name):
+            errors.append('%s: schema %s, appinfo.json %s' %
+                          (name, expected.get(name), actual.get(name)))
+    return errors
+
+
+if __name__ == '__main__':
+    schema = load(sys.argv[1] if len(sys.argv) > 1 else 'message_keys.json')
+    if len(sys.argv) > 2:
+        schema = select(schema, sys.argv[2].split(','))
+    for name, size in sorted(sizes(schema).items()):
+        print('%s: %d bytes' % (name, size))
@@ -0,0 +1,58 @@
+#
+# Build profiles (src/term_features.h), shared by wscript and test/Makefile.
+# Select one with
+#   ./waf configure --profile=status build   or   PEBBLE_TERM_PROFILE=status
+#
+# "sources" are the files under src/ a profile leaves out.
+#
+# Wakeups per hour are measured, not estimated here: make -C test bench
+# PROFILE=<name> runs the watchface against the simulated phone.
+#
+# Usage: python tools/profiles.py make > profiles.mk
+#
+
+import sys
+
+PROFILES = {
+    # clock lines only, no phone app; %T and %s need the second tick
+    'minimal': {
+        'features': [],
+        'sources': ['anim_scheduler.c', 'battery_log.c', 'feed_codec.c',
+                    'term_trace.c']
+    },
+    # status bar, typing animation and settings from the phone
+    'status': {
+        'features': ['typing', 'status', 'sync'],
+        'sources': ['feed_codec.c']
+    },
+    'full': {
+        'features': ['typing', 'status', 'sync', 'feed'],
+        'sources': []
+    }
+}
+
+DEFAULT_PROFILE = 'full'
+
+FEATURES = ['typing', 'status', 'sync', 'feed']
+
+
+def make_vars():
+    """The table as make variables, for test/Makefile."""
+    lines = [
+        '# Generated from tools/profiles.py. Do not edit.',
+        'PROFILE_NAMES := %s' % ' '.join(sorted(PROFILES)),
+        'DEFAULT_PROFILE := %s' % DEFAULT_PROFILE,
+        'FEATURE_NAMES := %s' % ' '.join(FEATURES)
+    ]
+
+    for name, profile in sorted(PROFILES.items()):
+        lines.append('FEATURES_%s := %s' % (name, ','.join(profile['features'])))
+        lines.append('EXCLUDE_%s := %s' % (name, ' '.join(profile['sources'])))
+    return '\n'.join(lines) + '\n'
+
+
+if __name__ == '__main__':
+    if sys.argv[1:] != ['make']:
+        sys.stderr.write('usage: python tools/profiles.py make\n')
+        sys.exit(2)
+    sys.stdout.write(make_vars())
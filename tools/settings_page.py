@@ -0,0 +1,145 @@
+#
+# Generates the settings page from message_keys.json as a data: URI,
+# bundled into the app script as SETTINGS_URL (src/js/settings_page.js).
+#
+# Every key with a "setting" and every entry of "phoneSettings" gets a
+# form field, so the page only offers what the build understands:
+#
+#   "setting": { "section": "Clock", "label": "...", "control": "toggle" }
+#
+# controls: toggle (0/1), select ("options": [[value, "label"], ...]),
+# text ("max": length), url.
+#
+# Current values come in the fragment (store.toURI), the page closes with
+# pebblejs://close#<encoded JSON> like the hosted page did.
+#
+# Usage: python tools/settings_page.py [message_keys.json] > settings.html
+#
+
+import json
+import re
+import sys
+
+try:
+    from urllib.parse import quote
+except ImportError:
+    from urllib import quote
+
+DATA_URI_PREFIX = 'data:text/html;charset=utf-8,'
+
+STYLE = '''
+body{margin:0;padding:8px;background:#000;color:#fff;font:15px monospace}
+h1{font-size:18px}h2{font-size:15px;border-bottom:1px solid #555}
+label{display:block;margin:10px 0}
+input[type=text],input[type=url],select{display:block;width:100%;
+box-sizing:border-box;margin-top:4px;padding:6px;font:inherit}
+button{width:48%;padding:10px;font:inherit}pre{white-space:pre-wrap;color:#999}
+'''
+
+# ES5 only, the phone web views are old
+SCRIPT = '''
+var v={},o=document.getElementById('f');
+location.hash.slice(1).split('&').forEach(function(p){
+  var i=p.indexOf('=');
+  if(i>0)v[decodeURIComponent(p.slice(0,i))]=decodeURIComponent(p.slice(i+1));
+});
+var s=null;
+F.forEach(function(f){
+  var c=f.setting,l=document.createElement('label'),e;
+  if(c.section!==s){
+    s=c.section;
+    var h=document.createElement('h2');
+    h.textContent=s;
+    o.appendChild(h);
+  }
+  if(c.control==='toggle'){
+    e=document.createElement('input');
+    e.type='checkbox';
+    e.checked=v[f.name]==='1';
+    l.appendChild(e);
+    l.appendChild(document.createTextNode(' '+c.label));
+  }else{
+    l.textContent=c.label;
+    if(c.control==='select'){
+      e=document.createElement('select');
+      c.options.forEach(function(p){
+        var i=document.createElement('option');
+        i.value=p[0];
+        i.textContent=p[1];
+        e.appendChild(i);
+      });
+    }else{
+      e=document.createElement('input');
+      e.type=c.control==='url'?'url':'text';
+      if(c.max)e.maxLength=c.max;
+    }
+    if(f.name in v)e.value=v[f.name];
+    l.appendChild(e);
+  }
+  e.name=f.name;
+  o.appendChild(l);
+});
+if(v.timing)document.getElementById('t').textContent='timing: '+v.timing;
+var close=function(r){location.href='pebblejs://close'+(r?'#'+encodeURIComponent(JSON.stringify(r)):'');};
+document.getElementById('s').onclick=function(){
+  var r={};
+  F.forEach(function(f){
+    var e=o.elements[f.name],c=f.setting.control;
+    r[f.name]=c==='toggle'?(e.checked?1:0):c==='select'?+e.value:e.value;
+  });
+  close(r);
+};
+document.getElementById('c').onclick=function(){close(null);};
+'''
+
+BODY = ('<h1>pebble&gt;settings</h1><form id="f" onsubmit="return false"></form>'
+        '<p><button id="c">Cancel</button> <button id="s">Save</button></p>'
+        '<pre id="t"></pre>')
+
+
+def fields(schema):
+    """Form fields grouped by section, in key order within a section."""
+    entries = [{'name': k['name'], 'setting': k['setting']}
+               for k in schema['keys'] + schema.get('phoneSettings', [])
+               if 'setting' in k]
+    sections = []
+
+    for entry in entries:
+        if entry['setting']['section'] not in sections:
+            sections.append(entry['setting']['section'])
+    return sorted(entries, key=lambda entry: sections.index(entry['setting']['section']))
+
+
+def minify(source):
+    # the sources above keep one statement or rule per line
+    return re.sub(r'\n\s*', '', source.strip())
+
+
+def html(schema):
+    script = 'var F=%s;%s' % (json.dumps(fields(schema), separators=(',', ':')),
+                              minify(SCRIPT))
+    return ('<!DOCTYPE html><html><head><meta charset="utf-8">'
+            '<meta name="viewport" content="width=device-width">'
+            '<title>Pebble Term Watch</title><style>%s</style></head>'
+            '<body>%s<script>%s</script></body></html>' %
+            (minify(STYLE), BODY, script))
+
+
+def data_uri(schema):
+    # '#' and '%' must be encoded, the fragment carries the values
+    return DATA_URI_PREFIX + quote(html(schema), safe='/:;=,()!*-._~')
+
+
+def js_source(schema):
+    return '\n'.join([
+        '// Generated from message_keys.json by wscript. Do not edit.',
+        '',
+        "var SETTINGS_URL = '%s';" % data_uri(schema),
+        ''
+    ])
+
+
+if __name__ == '__main__':
+    path = sys.argv[1] if len(sys.argv) > 1 else 'message_keys.json'
+    with open(path) as f:
+        sys.stdout.write(html(json.load(f)))